@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Minimal order type for the benchmarks: just what LevelBook reads.
+ *
+ * An aggregate (C++11: no default member initializers), so brace-inits
+ * spell out all four fields, `{buy, qty, px, false}`; std::vector's
+ * value-initialization leaves gtc false. Only purge_bench sets it.
+ */
+struct BenchOrder {
+  bool buy;
+  uint32_t qty;
+  int32_t px;
+  bool gtc; // good-till-cancel: survives the close
+  bool is_buy() const { return buy; }
+  uint32_t order_qty() const { return qty; }
+  int32_t price() const { return px; }
+  int32_t stop_price() const { return 0; }
+  bool all_or_none() const { return false; }
+  bool immediate_or_cancel() const { return false; }
+  bool hidden() const { return false; }
+  bool post_only() const { return false; }
+  uint32_t min_qty() const { return 0; }
+  bool good_till_cancel() const { return gtc; }
+};
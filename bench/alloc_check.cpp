@@ -0,0 +1,413 @@
+/**
+ * ============================================================================
+ * CHECK: Zero-Allocation Steady State
+ * ============================================================================
+ *
+ * Fails if the matching thread allocates memory once the book is warm.
+ *
+ * A heap allocation on the hot path costs far more than the matching
+ * around it, and its cost is unpredictable: malloc can take a lock, touch
+ * a cold page or call into the kernel. Every container in LevelBook is
+ * meant to reach its working size during warm-up and then only reuse its
+ * memory. This program keeps that promise honest.
+ *
+ * - Global operator new and, with glibc, malloc/calloc/realloc are
+ *   replaced by versions that count calls per thread.
+ * - A matching thread replays a long random order flow through a
+ *   LevelBook<SimpleOrder *> with listeners that react to every event
+ *   (tracking which orders rest, like MyOrderListener but silent).
+ * - The first part of the replay is warm-up: the mid price sweeps its
+ *   whole range once, then the random flow runs in chunks until a whole
+ *   chunk makes no allocation. After it, the thread is "armed": each
+ *   allocation it makes is counted, and the call stacks of the first few
+ *   are saved.
+ * - At the end, the armed count is printed with the saved stacks; the
+ *   exit status is 1 if it isn't zero.
+ *
+ * Stacks are printed with backtrace_symbols_fd(); pipe the output through
+ * c++filt for readable names. A level queue that gets busier than it has
+ * ever been still grows its arrays once, so runs far longer than the
+ * default can catch a few of those rare peaks.
+ *
+ * Usage: alloc_check [operations after warm-up]
+ */
+
+#include <LevelBook.h>
+#include <SimpleOrder.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+
+namespace {
+
+/// Per-thread counters. Plain data, so thread_local needs no constructor
+/// (which could itself allocate).
+struct ThreadAllocations {
+  uint64_t count;       // every allocation on this thread
+  uint64_t armed_count; // allocations while armed
+  uint64_t armed_bytes;
+  bool armed;
+  bool sampling; // inside backtrace(): don't count or sample again
+};
+
+thread_local ThreadAllocations allocations;
+
+/// Call stack of one allocation made while armed
+struct Sample {
+  size_t bytes;
+  int depth;
+  void *frames[32];
+};
+
+const int MAX_SAMPLES = 8;
+Sample samples[MAX_SAMPLES]; // fixed storage: sampling must not allocate
+int sample_count = 0;
+
+void note_allocation(size_t bytes) {
+  ThreadAllocations &mine = allocations;
+  ++mine.count;
+  if (!mine.armed || mine.sampling) {
+    return;
+  }
+  ++mine.armed_count;
+  mine.armed_bytes += bytes;
+  if (sample_count < MAX_SAMPLES) {
+    mine.sampling = true;
+    Sample &sample = samples[sample_count++];
+    sample.bytes = bytes;
+    sample.depth = backtrace(sample.frames, 32);
+    mine.sampling = false;
+  }
+}
+
+} // namespace
+
+#if defined(__GLIBC__)
+// glibc exports its allocator under these names as well, so the
+// replacements below can forward to it without dlsym() (which allocates)
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+
+void *malloc(size_t size) {
+  note_allocation(size);
+  return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size) {
+  note_allocation(count * size);
+  return __libc_calloc(count, size);
+}
+void *realloc(void *ptr, size_t size) {
+  note_allocation(size);
+  return __libc_realloc(ptr, size);
+}
+void free(void *ptr) { __libc_free(ptr); }
+}
+#define COUNT_NEW(size) // operator new goes through malloc above
+#else
+#define COUNT_NEW(size) note_allocation(size)
+#endif
+
+void *operator new(size_t size) {
+  COUNT_NEW(size);
+  void *ptr = std::malloc(size ? size : 1);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  COUNT_NEW(size);
+  return std::malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+/// Start counting this thread's allocations
+static void arm() {
+  void *frames[4];
+  backtrace(frames, 4); // first call loads the unwinder: do it now
+  allocations.armed = true;
+}
+
+static void disarm() { allocations.armed = false; }
+
+// ---------------------------------------------------------------------------
+// Replay
+// ---------------------------------------------------------------------------
+
+typedef LevelBook<SimpleOrder *> Book;
+
+/**
+ * Drives the book with a random order flow and keeps track, from the
+ * book's own events, of which pool orders are resting.
+ *
+ * Orders are reused: an order that is filled, canceled or never rested
+ * goes back to the idle list and is later submitted again with new terms
+ * (accept_replace()). All lists are sized up front.
+ */
+class Replay : public liquibook::book::OrderListener<SimpleOrder *>,
+               public BboChangeListener<Book> {
+public:
+  explicit Replay(std::vector<SimpleOrder> &pool)
+      : pool_(pool), state_(pool.size(), IDLE), slot_(pool.size(), 0),
+        seed_(0x9e3779b97f4a7c15ULL), mid_(10000), direction_(1),
+        fills_(0), bbo_changes_(0) {
+    book_.set_order_listener(this);
+    book_.set_bbo_listener(this);
+    idle_.reserve(pool.size());
+    live_.reserve(pool.size());
+    for (uint32_t i = 0; i < pool.size(); ++i) {
+      idle_.push_back(i);
+    }
+  }
+
+  /**
+   * Run `count` random operations, each followed by perform_callbacks().
+   *
+   * @param sweep  move the mid steadily from one end of its range to the
+   *               other and back, instead of at random, so warm-up sees
+   *               every price the book can reach
+   */
+  void run(uint64_t count, bool sweep = false) {
+    for (uint64_t op = 0; op < count; ++op) {
+      if ((op & 255) == 0) {
+        drift(sweep);
+      }
+      uint32_t r = random(100);
+      bool full = live_.size() >= MAX_RESTING || idle_.empty();
+      if (live_.empty() || (r < 50 && !full)) {
+        submit(false);
+      } else if (r < 65 && !full) {
+        submit(true);
+      } else if (r < 85 || full) {
+        cancel();
+      } else {
+        replace();
+      }
+    }
+  }
+
+  uint64_t fills() const { return fills_; }
+  uint64_t bbo_changes() const { return bbo_changes_; }
+  size_t resting() const { return book_.resting_count(); }
+
+  void on_accept(SimpleOrder *const &) override {}
+  void on_reject(SimpleOrder *const &order, const char *) override {
+    retire(order);
+  }
+  void on_fill(SimpleOrder *const &order, SimpleOrder *const &matched,
+               liquibook::book::Quantity, liquibook::book::Price) override {
+    ++fills_;
+    OrderStatus status;
+    if (!book_.order_status(matched, status)) {
+      retire(matched);
+    }
+    if (!book_.order_status(order, status)) {
+      retire(order); // a replaced order that traded away
+    }
+  }
+  void on_cancel(SimpleOrder *const &order) override { retire(order); }
+  void on_cancel_reject(SimpleOrder *const &, const char *) override {}
+  void on_replace(SimpleOrder *const &order, const int64_t &size_delta,
+                  liquibook::book::Price new_price) override {
+    order->accept_replace(uint32_t(order->order_qty() + size_delta),
+                          int32_t(new_price));
+  }
+  void on_replace_reject(SimpleOrder *const &, const char *) override {}
+
+  void on_bbo_change(const Book *, const Bbo &) override { ++bbo_changes_; }
+
+private:
+  enum State { IDLE, PENDING, LIVE };
+
+  /// Deep levels rarely trade; past this many resting orders, cancel
+  static const size_t MAX_RESTING = 5000;
+  static const int32_t MID_LOW = 9980; // range of the mid price
+  static const int32_t MID_HIGH = 10020;
+
+  uint32_t random(uint32_t below) {
+    seed_ ^= seed_ >> 12;
+    seed_ ^= seed_ << 25;
+    seed_ ^= seed_ >> 27;
+    return uint32_t((seed_ * 2685821657736338717ULL) >> 33) % below;
+  }
+
+  /// Move the mid price one tick now and then, so levels come and go
+  void drift(bool sweep) {
+    int32_t step = sweep ? direction_ : int32_t(random(3)) - 1;
+    if (mid_ + step < MID_LOW || mid_ + step > MID_HIGH) {
+      direction_ = -direction_;
+      return;
+    }
+    mid_ += step;
+  }
+
+  /// Submit an idle order: passive (rests near the mid) or aggressive
+  /// (crosses it)
+  void submit(bool aggressive) {
+    uint32_t pick = random(uint32_t(idle_.size()));
+    uint32_t index = idle_[pick];
+    idle_[pick] = idle_.back();
+    idle_.pop_back();
+    state_[index] = PENDING;
+
+    SimpleOrder *order = &pool_[index];
+    int32_t offset = aggressive ? -int32_t(random(4)) : int32_t(1 + random(20));
+    int32_t price = order->is_buy() ? mid_ - offset : mid_ + offset;
+    order->accept_replace(1 + random(100), price);
+    book_.add(order, aggressive && random(2) == 0
+                         ? liquibook::book::oc_immediate_or_cancel
+                         : 0);
+    book_.perform_callbacks();
+
+    OrderStatus status;
+    if (state_[index] == PENDING) {
+      if (book_.order_status(order, status)) {
+        state_[index] = LIVE;
+        slot_[index] = uint32_t(live_.size());
+        live_.push_back(index);
+      } else {
+        state_[index] = IDLE;
+        idle_.push_back(index);
+      }
+    }
+  }
+
+  void cancel() {
+    if (live_.empty()) {
+      return;
+    }
+    book_.cancel(&pool_[live_[random(uint32_t(live_.size()))]]);
+    book_.perform_callbacks();
+  }
+
+  /// Change size and/or price of a resting order
+  void replace() {
+    SimpleOrder *order = &pool_[live_[random(uint32_t(live_.size()))]];
+    OrderStatus status;
+    if (!book_.order_status(order, status)) {
+      return;
+    }
+    int64_t delta = int64_t(random(40)) - int64_t(status.open_qty / 2) - 10;
+    if (int64_t(status.open_qty) + delta <= 0) {
+      delta = 0;
+    }
+    liquibook::book::Price price = status.price;
+    if (random(2) == 0) { // reprice near the mid, like a new passive order
+      int32_t offset = int32_t(1 + random(20));
+      price = order->is_buy() ? mid_ - offset : mid_ + offset;
+    }
+    book_.replace(order, delta, price);
+    book_.perform_callbacks();
+  }
+
+  /// The order is no longer resting
+  void retire(SimpleOrder *order) {
+    uint32_t index = uint32_t(order - &pool_[0]);
+    if (state_[index] != LIVE) {
+      return; // still being submitted: submit() files it
+    }
+    uint32_t moved = live_.back();
+    live_[slot_[index]] = moved;
+    slot_[moved] = slot_[index];
+    live_.pop_back();
+    state_[index] = IDLE;
+    idle_.push_back(index);
+  }
+
+  std::vector<SimpleOrder> &pool_;
+  Book book_;
+  std::vector<uint8_t> state_;  // pool index -> State
+  std::vector<uint32_t> slot_;  // pool index -> position in live_
+  std::vector<uint32_t> idle_;  // orders free to submit
+  std::vector<uint32_t> live_;  // orders resting in the book
+  uint64_t seed_;
+  int32_t mid_;
+  int32_t direction_; // of the warm-up sweep
+  uint64_t fills_;
+  uint64_t bbo_changes_;
+};
+
+int main(int argc, char **argv) {
+  const uint64_t operations =
+      argc > 1 ? std::strtoull(argv[1], NULL, 10) : 2000000;
+  const uint64_t chunk = 1000000; // warm-up step
+  const int max_chunks = 20;
+  const uint32_t pool_size = 20000;
+
+  // SimpleOrder logs when constructed: build the pool with std::cout muted
+  std::vector<SimpleOrder> pool;
+  pool.reserve(pool_size);
+  std::streambuf *saved = std::cout.rdbuf(NULL);
+  for (uint32_t i = 0; i < pool_size; ++i) {
+    std::ostringstream id;
+    id << "A" << i;
+    pool.push_back(SimpleOrder(i % 2 == 0, 1, 10000, id.str()));
+  }
+  std::cout.rdbuf(saved);
+
+  Replay replay(pool);
+  uint64_t warmup = 0, warmup_allocations = 0, armed = 0, armed_bytes = 0;
+  std::thread matching([&] {
+    // Warm until a whole chunk of the random flow runs without allocating:
+    // queues keep growing now and then until each has seen its busiest day
+    replay.run(chunk, true);
+    warmup = chunk;
+    uint64_t before;
+    do {
+      before = allocations.count;
+      replay.run(chunk);
+      warmup += chunk;
+    } while (allocations.count != before && warmup < max_chunks * chunk);
+    warmup_allocations = allocations.count;
+    arm();
+    replay.run(operations);
+    disarm();
+    armed = allocations.armed_count;
+    armed_bytes = allocations.armed_bytes;
+  });
+  matching.join();
+
+  std::cout << "operations:   " << warmup << " warm-up + " << operations
+            << " checked (" << replay.fills() << " fills, "
+            << replay.bbo_changes() << " BBO changes, " << replay.resting()
+            << " resting at the end)" << std::endl;
+  std::cout << "warm-up:      " << warmup_allocations << " allocations"
+            << std::endl;
+  std::cout << "steady state: " << armed << " allocations, " << armed_bytes
+            << " bytes" << std::endl;
+  if (armed == 0) {
+    std::cout << "PASS: no allocations after warm-up" << std::endl;
+    return 0;
+  }
+
+  std::cout << "FAIL: the matching thread allocated after warm-up; first "
+            << sample_count << " call stacks:" << std::endl;
+  for (int s = 0; s < sample_count; ++s) {
+    std::cout << "\n#" << s + 1 << ": " << samples[s].bytes << " bytes"
+              << std::endl;
+    backtrace_symbols_fd(samples[s].frames, samples[s].depth, STDOUT_FILENO);
+  }
+  return 1;
+}
@@ -0,0 +1,413 @@
+/**
+ * ============================================================================
+ * TOOL: Benchmark A/B Comparison
+ * ============================================================================
+ *
+ * Compares two benchmark result files written by BenchReport (BENCH_JSON)
+ * and flags regressions.
+ *
+ *   BENCH_JSON=base.jsonl ./match_bench    (a few times, on the old build)
+ *   BENCH_JSON=new.jsonl  ./match_bench    (same, on the new build)
+ *   ./bench_compare base.jsonl new.jsonl [threshold %] [tail percentile]
+ *
+ * For every measurement in both files it compares the median (typical
+ * cost per op) and, with enough samples, a tail percentile (p99 by
+ * default). Each change comes with a 95% confidence interval from a
+ * bootstrap: both sides are resampled with replacement a few thousand
+ * times and the change recomputed each time, which works for medians and
+ * percentiles without assuming a normal distribution. Resampling is two
+ * level - whole runs first, then samples within each run - because runs
+ * differ from each other (memory layout, CPU frequency, neighbours) by
+ * more than samples within a run do. With a single run per side that
+ * difference can't be seen, so run each side at least 3 times.
+ *
+ * A change is a REGRESSION when it is worse than the threshold (5% by
+ * default) and its whole confidence interval is above zero, i.e. it is
+ * unlikely to be noise. More repetitions give tighter intervals. The exit
+ * status is 1 if anything regressed, so the tool can gate a CI job.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// Just enough JSON for BenchReport's output
+struct Json {
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+  Type type = NUL;
+  double number = 0;
+  std::string text;
+  std::vector<Json> items;
+  std::vector<std::pair<std::string, Json> > fields;
+
+  const Json *get(const std::string &key) const {
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (fields[i].first == key) {
+        return &fields[i].second;
+      }
+    }
+    return NULL;
+  }
+
+  std::string str(const std::string &key) const {
+    const Json *value = get(key);
+    return value != NULL && value->type == STRING ? value->text : "";
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(const std::string &text) : text_(text), pos_(0) {}
+
+  bool parse(Json &out) {
+    return value(out) && (skip(), pos_ == text_.size());
+  }
+
+private:
+  void skip() {
+    while (pos_ < text_.size() && std::isspace((unsigned char)text_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  bool literal(const char *word) {
+    size_t n = std::string(word).size();
+    if (text_.compare(pos_, n, word) != 0) {
+      return false;
+    }
+    pos_ += n;
+    return true;
+  }
+
+  bool string(std::string &out) {
+    if (text_[pos_] != '"') {
+      return false;
+    }
+    for (++pos_; pos_ < text_.size(); ++pos_) {
+      char c = text_[pos_];
+      if (c == '"') {
+        ++pos_;
+        return true;
+      }
+      if (c == '\\' && ++pos_ < text_.size()) {
+        c = text_[pos_];
+        if (c == 'u' && pos_ + 4 < text_.size()) {
+          out += char(std::strtol(text_.substr(pos_ + 1, 4).c_str(), NULL,
+                                  16));
+          pos_ += 4;
+          continue;
+        }
+        c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+      }
+      out += c;
+    }
+    return false;
+  }
+
+  bool value(Json &out) {
+    skip();
+    if (pos_ >= text_.size()) {
+      return false;
+    }
+    char c = text_[pos_];
+    if (c == '{') {
+      out.type = Json::OBJECT;
+      ++pos_;
+      skip();
+      if (pos_ < text_.size() && text_[pos_] == '}') {
+        ++pos_;
+        return true;
+      }
+      for (;;) {
+        skip();
+        std::pair<std::string, Json> field;
+        if (!string(field.first)) {
+          return false;
+        }
+        skip();
+        if (pos_ >= text_.size() || text_[pos_++] != ':' ||
+            !value(field.second)) {
+          return false;
+        }
+        out.fields.push_back(field);
+        skip();
+        if (pos_ < text_.size() && text_[pos_] == ',') {
+          ++pos_;
+        } else {
+          return pos_ < text_.size() && text_[pos_++] == '}';
+        }
+      }
+    }
+    if (c == '[') {
+      out.type = Json::ARRAY;
+      ++pos_;
+      skip();
+      if (pos_ < text_.size() && text_[pos_] == ']') {
+        ++pos_;
+        return true;
+      }
+      for (;;) {
+        out.items.push_back(Json());
+        if (!value(out.items.back())) {
+          return false;
+        }
+        skip();
+        if (pos_ < text_.size() && text_[pos_] == ',') {
+          ++pos_;
+        } else {
+          return pos_ < text_.size() && text_[pos_++] == ']';
+        }
+      }
+    }
+    if (c == '"') {
+      out.type = Json::STRING;
+      return string(out.text);
+    }
+    if (literal("true") || literal("false")) {
+      out.type = Json::BOOL;
+      return true;
+    }
+    if (literal("null")) {
+      return true;
+    }
+    char *end = NULL;
+    out.type = Json::NUMBER;
+    out.number = std::strtod(text_.c_str() + pos_, &end);
+    if (end == text_.c_str() + pos_) {
+      return false;
+    }
+    pos_ = size_t(end - text_.c_str());
+    return true;
+  }
+
+  const std::string &text_;
+  size_t pos_;
+};
+
+struct Measurement {
+  std::string unit;
+  std::vector<std::vector<double> > runs; // one line of the file each
+
+  std::vector<double> all() const {
+    std::vector<double> pooled;
+    for (size_t r = 0; r < runs.size(); ++r) {
+      pooled.insert(pooled.end(), runs[r].begin(), runs[r].end());
+    }
+    return pooled;
+  }
+};
+
+struct ResultFile {
+  std::map<std::string, Measurement> measurements; // "bench/name"
+  Json env;                                        // of the first line
+};
+
+static bool load(const char *path, ResultFile &file) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "can't read " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  size_t number = 0;
+  while (std::getline(in, line)) {
+    ++number;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    Json entry;
+    if (!JsonParser(line).parse(entry) || entry.type != Json::OBJECT) {
+      std::cerr << path << ":" << number << ": not a result line" << std::endl;
+      continue;
+    }
+    Measurement &m =
+        file.measurements[entry.str("bench") + "/" + entry.str("name")];
+    m.unit = entry.str("unit");
+    m.runs.push_back(std::vector<double>());
+    const Json *samples = entry.get("samples");
+    for (size_t i = 0; samples != NULL && i < samples->items.size(); ++i) {
+      m.runs.back().push_back(samples->items[i].number);
+    }
+    const Json *env = entry.get("env");
+    if (env != NULL && file.env.type == Json::NUL) {
+      file.env = *env;
+    }
+  }
+  return true;
+}
+
+/// @param q  0..1
+static double quantile(std::vector<double> values, double q) {
+  size_t k = size_t(q * double(values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+/// Deterministic generator for the bootstrap (xorshift64*)
+struct Random {
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  size_t below(size_t n) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return size_t((state * 2685821657736338717ULL) >> 11) % n;
+  }
+};
+
+struct Change {
+  double base = 0;
+  double next = 0;
+  double percent = 0; // (next - base) / base * 100
+  double low = 0;     // 95% confidence interval of percent
+  double high = 0;
+  bool valid = false; // enough samples for an interval
+};
+
+/// One bootstrap replicate: random runs, then random samples of each
+static void resample(const Measurement &m, Random &random,
+                     std::vector<double> &out) {
+  out.clear();
+  for (size_t r = 0; r < m.runs.size(); ++r) {
+    const std::vector<double> &run = m.runs[random.below(m.runs.size())];
+    for (size_t i = 0; i < run.size(); ++i) {
+      out.push_back(run[random.below(run.size())]);
+    }
+  }
+}
+
+/// Percent change of quantile `q` from `a` to `b`, bootstrapped
+static Change compare(const Measurement &a, const Measurement &b, double q) {
+  Change change;
+  std::vector<double> pooled_a = a.all(), pooled_b = b.all();
+  change.base = quantile(pooled_a, q);
+  change.next = quantile(pooled_b, q);
+  change.percent = (change.next - change.base) / change.base * 100;
+  if (pooled_a.size() < 2 || pooled_b.size() < 2) {
+    return change;
+  }
+  const int rounds = 2000;
+  Random random;
+  std::vector<double> percents(rounds);
+  std::vector<double> ra, rb;
+  for (int r = 0; r < rounds; ++r) {
+    resample(a, random, ra);
+    resample(b, random, rb);
+    if (ra.empty() || rb.empty()) {
+      percents[r] = change.percent; // drew only empty runs
+      continue;
+    }
+    double qa = quantile(ra, q);
+    percents[r] = (quantile(rb, q) - qa) / qa * 100;
+  }
+  std::sort(percents.begin(), percents.end());
+  change.low = percents[size_t(rounds * 0.025)];
+  change.high = percents[size_t(rounds * 0.975)];
+  change.valid = true;
+  return change;
+}
+
+/// @return "REGRESSION", "improved" or "" for no significant change
+static const char *verdict(const Change &c, double threshold) {
+  if (!c.valid) {
+    return "(n<2)";
+  }
+  if (c.percent > threshold && c.low > 0) {
+    return "REGRESSION";
+  }
+  if (c.percent < -threshold && c.high < 0) {
+    return "improved";
+  }
+  return "";
+}
+
+static void print_change(const Change &c, double threshold) {
+  std::cout << std::setw(12) << c.base << std::setw(12) << c.next
+            << std::showpos << std::setw(9) << c.percent << "%";
+  if (c.valid) {
+    std::cout << "  [" << c.low << ", " << c.high << "]";
+  }
+  std::cout << std::noshowpos << "  " << verdict(c, threshold) << std::endl;
+}
+
+static void print_env(const char *label, const ResultFile &file) {
+  std::cout << label << ": git " << file.env.str("git") << ", "
+            << file.env.str("build") << ", " << file.env.str("cpu")
+            << "\n      flags: " << file.env.str("flags") << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: bench_compare base.jsonl new.jsonl [threshold %] "
+                 "[tail percentile]"
+              << std::endl;
+    return 2;
+  }
+  const double threshold = argc > 3 ? std::atof(argv[3]) : 5.0;
+  const double tail = argc > 4 ? std::atof(argv[4]) : 99.0;
+  const size_t tail_samples = size_t(100 / (100 - tail)); // >= 1 past tail
+
+  ResultFile base, next;
+  if (!load(argv[1], base) || !load(argv[2], next)) {
+    return 2;
+  }
+  print_env("base", base);
+  print_env("new ", next);
+  if (base.env.str("cpu") != next.env.str("cpu")) {
+    std::cout << "warning: different CPUs, comparison may be meaningless"
+              << std::endl;
+  }
+
+  std::cout << std::fixed << std::setprecision(1) << "\n"
+            << std::left << std::setw(40) << "measurement" << std::right
+            << std::setw(12) << "base" << std::setw(12) << "new"
+            << std::setw(10) << "change" << "  95% CI" << std::endl;
+  int regressions = 0;
+  bool single_run = false;
+  std::map<std::string, Measurement>::const_iterator it;
+  for (it = base.measurements.begin(); it != base.measurements.end(); ++it) {
+    std::map<std::string, Measurement>::const_iterator other =
+        next.measurements.find(it->first);
+    if (other == next.measurements.end()) {
+      continue;
+    }
+    const Measurement &a = it->second;
+    const Measurement &b = other->second;
+    const std::string &unit = a.unit;
+    const size_t count_a = a.all().size(), count_b = b.all().size();
+    if (count_a == 0 || count_b == 0) {
+      continue;
+    }
+    single_run |= a.runs.size() < 2 || b.runs.size() < 2;
+
+    Change median = compare(a, b, 0.5);
+    std::cout << std::left << std::setw(40)
+              << it->first + " median " + unit << std::right;
+    print_change(median, threshold);
+    regressions += std::string(verdict(median, threshold)) == "REGRESSION";
+
+    if (count_a >= tail_samples && count_b >= tail_samples) {
+      std::ostringstream label;
+      label << it->first << " p" << tail << " " << unit;
+      Change high = compare(a, b, tail / 100);
+      std::cout << std::left << std::setw(40) << label.str() << std::right;
+      print_change(high, threshold);
+      regressions += std::string(verdict(high, threshold)) == "REGRESSION";
+    }
+  }
+  if (single_run) {
+    std::cout << "\nnote: some measurements have a single run per side; "
+                 "their intervals ignore run-to-run variation"
+              << std::endl;
+  }
+  std::cout << "\n" << regressions << " regression(s) beyond " << threshold
+            << "%" << std::endl;
+  return regressions ? 1 : 0;
+}
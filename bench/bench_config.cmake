@@ -0,0 +1,35 @@
+# Writes bench_config.h for BenchReport: git hash, compiler flags and build
+# type. Run on every build (see CMakeLists.txt) so the hash never goes
+# stale; the file is only touched when something changed.
+#
+# Inputs: SRC (source dir), OUT (header path), FLAGS, BUILD_TYPE
+execute_process(
+  COMMAND git rev-parse --short HEAD
+  WORKING_DIRECTORY ${SRC}
+  OUTPUT_VARIABLE GIT_HASH
+  OUTPUT_STRIP_TRAILING_WHITESPACE
+  ERROR_QUIET)
+execute_process(
+  COMMAND git status --porcelain --untracked-files=no
+  WORKING_DIRECTORY ${SRC}
+  OUTPUT_VARIABLE GIT_DIRTY
+  OUTPUT_STRIP_TRAILING_WHITESPACE
+  ERROR_QUIET)
+if(NOT GIT_HASH)
+  set(GIT_HASH "unknown")
+elseif(GIT_DIRTY)
+  set(GIT_HASH "${GIT_HASH}-dirty")
+endif()
+string(REPLACE "\"" "\\\"" FLAGS "${FLAGS}")
+
+set(CONTENT "#pragma once
+#define BENCH_GIT_HASH \"${GIT_HASH}\"
+#define BENCH_CXX_FLAGS \"${FLAGS}\"
+#define BENCH_BUILD_TYPE \"${BUILD_TYPE}\"
+")
+if(EXISTS ${OUT})
+  file(READ ${OUT} OLD)
+endif()
+if(NOT "${OLD}" STREQUAL "${CONTENT}")
+  file(WRITE ${OUT} "${CONTENT}")
+endif()
@@ -0,0 +1,100 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Event Timestamp Clocks
+ * ============================================================================
+ *
+ * Cost per read of TscClock::now() against steady_clock::now(), then how
+ * far TscClock is from steady_clock after running with a TscCalibrator,
+ * and a check that no thread ever sees TscClock go backwards.
+ */
+
+#include <BenchReport.h>
+#include <TscClock.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static uint64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// @return nanoseconds per call of `read`
+template <class Read> static double cost(Read read, int calls) {
+  uint64_t sink = 0;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    sink += read();
+  }
+  std::chrono::steady_clock::time_point stop =
+      std::chrono::steady_clock::now();
+  if (sink == 42) {
+    std::cout << ""; // keep the loop from being optimized away
+  }
+  return std::chrono::duration<double, std::nano>(stop - start).count() /
+         calls;
+}
+
+static uint64_t tsc_now() { return TscClock::now(); }
+
+#if TSC_CLOCK_X86
+static uint64_t raw_tsc() { return __rdtsc(); }
+#endif
+
+int main() {
+  TscCalibrator calibrator(std::chrono::milliseconds(50));
+  const int calls = 20000000;
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "TSC in use:           " << (TscClock::uses_tsc() ? "yes" : "no")
+            << " (" << std::setprecision(4) << TscClock::ns_per_tick()
+            << " ns/tick)" << std::endl;
+  std::cout << std::setprecision(1);
+  BenchReport report("clock_bench");
+  double steady_cost = cost(steady_ns, calls);
+  double tsc_cost = cost(tsc_now, calls);
+  report.add("steady_clock", "ns", steady_cost);
+  report.add("TscClock", "ns", tsc_cost);
+  std::cout << "steady_clock::now():  " << steady_cost << " ns" << std::endl;
+  std::cout << "TscClock::now():      " << tsc_cost << " ns" << std::endl;
+#if TSC_CLOCK_X86
+  // The floor: under some hypervisors rdtsc itself traps and is slow
+  std::cout << "raw rdtsc:            " << cost(raw_tsc, calls) << " ns"
+            << std::endl;
+#endif
+
+  // Several threads reading at once while the calibrator runs
+  std::atomic<uint64_t> backwards(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&backwards] {
+      uint64_t last = 0;
+      uint64_t end = steady_ns() + 1000000000; // 1 s
+      while (steady_ns() < end) {
+        for (int i = 0; i < 1000; ++i) {
+          uint64_t now = TscClock::now();
+          if (now < last) {
+            ++backwards;
+          }
+          last = now;
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+
+  int64_t offset = int64_t(TscClock::now() - steady_ns());
+  std::cout << "Offset from steady:   " << offset << " ns after ~1 s"
+            << std::endl;
+  std::cout << "Backward steps seen:  " << backwards.load() << std::endl;
+  report.write();
+  return 0;
+}
@@ -0,0 +1,348 @@
+/**
+ * ============================================================================
+ * BENCHMARK: OS Jitter and Scheduling Noise
+ * ============================================================================
+ *
+ * Tells apart latency spikes caused by the machine from spikes caused by
+ * the engine, on the cores meant for matching shards.
+ *
+ * Phase 1, host: one thread pinned to each core spins reading TscClock.
+ * Back-to-back reads are a few nanoseconds apart, so any longer gap is
+ * time the core was taken away: an interrupt, a preemption, an SMI, a
+ * hypervisor exit. Every gap goes into a LatencyHistogram; gaps over the
+ * threshold are also kept with their time, and a gap that overlaps gaps
+ * on at least half the other cores counts as machine-wide (SMIs and
+ * hypervisor pauses stop every core; interrupts and preemption hit one).
+ *
+ * Phase 2, engine: one thread pinned to each core runs its own LevelBook
+ * shard flat out (adds, trades, cancels) and times every operation into
+ * a LatencyHistogram.
+ *
+ * Correlation: a thread that is always busy absorbs each host gap into
+ * whichever operation is running, so host gaps of at least T per second
+ * and engine operations of at least T per second should match wherever
+ * the host is to blame. For each core the report lists both rates over a
+ * ladder of T and the share of engine outliers the host explains. Where
+ * that share is high, tune the machine (isolcpus, nohz_full, IRQ
+ * affinity, power states) before touching the code. The phases run one
+ * after the other, so this assumes the host's noise is steady.
+ *
+ * No TscCalibrator runs: its wakeups would land on the cores being
+ * measured.
+ *
+ * Usage: jitter_bench [seconds per phase] [threshold ns] [core ...]
+ *        (default: 5 s, 1000 ns, every core this process may use)
+ */
+
+#include <BenchReport.h>
+#include <LatencyHistogram.h>
+#include <LevelBook.h>
+#include <TscClock.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "BenchOrder.h"
+
+/// A stretch of time a core was taken away from the probe
+struct Gap {
+  uint64_t start;
+  uint64_t end;
+  int core; // index into the core list
+};
+
+struct CoreResult {
+  int core;
+  bool pinned;
+  LatencyHistogram gaps; // time between consecutive clock reads
+  uint64_t stolen_ns;    // sum of gaps over the threshold
+  std::vector<Gap> events;
+  size_t machine_wide;
+  LatencyHistogram ops; // engine operation latency
+};
+
+/// Pin the calling thread to `core`
+static bool pin(int core) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)core;
+  return false;
+#endif
+}
+
+/// Cores this process may run on
+static std::vector<int> allowed_cores() {
+  std::vector<int> cores;
+#ifdef __linux__
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c, &set)) {
+        cores.push_back(c);
+      }
+    }
+  }
+#endif
+  if (cores.empty()) {
+    for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c) {
+      cores.push_back(int(c));
+    }
+  }
+  return cores;
+}
+
+static const size_t MAX_EVENTS = 1 << 16; // per core
+
+/// Spin reading the clock for `ns`, recording every gap
+static void probe(CoreResult &result, int index, uint64_t ns,
+                  uint64_t threshold) {
+  uint64_t last = TscClock::now();
+  const uint64_t end = last + ns;
+  while (last < end) {
+    uint64_t now = TscClock::now();
+    uint64_t gap = now - last;
+    result.gaps.record(gap);
+    if (gap >= threshold) {
+      result.stolen_ns += gap;
+      if (result.events.size() < MAX_EVENTS) {
+        Gap event = {last, now, index};
+        result.events.push_back(event);
+      }
+    }
+    last = now;
+  }
+}
+
+/// Run a book shard flat out for `ns`, timing every operation
+static void engine(CoreResult &result, uint64_t ns) {
+  LevelBook<BenchOrder *> book("JITTER");
+  const size_t ring = 1024; // each slot alternates add / cancel
+  std::vector<BenchOrder> orders(ring);
+  std::vector<char> added(ring, 0);
+  uint64_t seed = 42 + uint64_t(result.core);
+  const uint64_t end = TscClock::now() + ns;
+  for (uint64_t op = 0;; ++op) {
+    size_t slot = op & (ring - 1);
+    BenchOrder &order = orders[slot];
+    if (!added[slot]) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      order.buy = (seed >> 40) & 1;
+      order.qty = uint32_t(1 + (seed >> 33) % 100);
+      // Mostly passive, sometimes one tick through the touch
+      int32_t offset = int32_t((seed >> 20) % 8) - 1;
+      order.px = order.buy ? 10000 - offset : 10001 + offset;
+    }
+    uint64_t start = TscClock::now();
+    if (start >= end) {
+      break;
+    }
+    if (added[slot]) {
+      book.cancel(&order); // a filled order just gets a cancel reject
+    } else {
+      book.add(&order);
+    }
+    book.perform_callbacks();
+    result.ops.record(TscClock::now() - start);
+    added[slot] ^= 1;
+  }
+}
+
+/// Run `phase` on every core at once, each thread pinned to its core
+template <class Phase>
+static void on_every_core(std::vector<CoreResult> &results, Phase phase) {
+  std::atomic<size_t> ready(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < results.size(); ++i) {
+    threads.push_back(std::thread([&results, &ready, &phase, i] {
+      results[i].pinned = pin(results[i].core);
+      ++ready;
+      while (ready.load() < results.size()) {
+      }
+      phase(results[i], int(i));
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+/// Flag gaps that overlap gaps on at least half of the other cores
+static void find_machine_wide(std::vector<CoreResult> &results) {
+  if (results.size() < 2) {
+    return;
+  }
+  std::vector<Gap> all;
+  uint64_t longest = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    for (size_t e = 0; e < results[i].events.size(); ++e) {
+      all.push_back(results[i].events[e]);
+      longest = std::max(longest, results[i].events[e].end -
+                                      results[i].events[e].start);
+    }
+  }
+  std::sort(all.begin(), all.end(),
+            [](const Gap &a, const Gap &b) { return a.start < b.start; });
+  const size_t needed = results.size() / 2; // half the others, rounded up
+  std::vector<char> seen(results.size());
+  for (size_t i = 0; i < all.size(); ++i) {
+    std::fill(seen.begin(), seen.end(), 0);
+    size_t others = 0;
+    // Overlapping gaps start no earlier than start - longest
+    size_t j = i;
+    while (j > 0 && all[j - 1].start + longest >= all[i].start) {
+      --j;
+    }
+    for (; j < all.size() && all[j].start <= all[i].end; ++j) {
+      if (all[j].core != all[i].core && all[j].end >= all[i].start &&
+          !seen[all[j].core]) {
+        seen[all[j].core] = 1;
+        ++others;
+      }
+    }
+    if (others >= needed) {
+      ++results[all[i].core].machine_wide;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+  const uint64_t threshold = argc > 2 ? std::strtoull(argv[2], NULL, 10) : 1000;
+  std::vector<int> cores;
+  for (int a = 3; a < argc; ++a) {
+    cores.push_back(std::atoi(argv[a]));
+  }
+  if (cores.empty()) {
+    cores = allowed_cores();
+  }
+  const uint64_t ns = uint64_t(seconds * 1e9);
+
+  std::vector<CoreResult> results(cores.size());
+  for (size_t i = 0; i < cores.size(); ++i) {
+    results[i].core = cores[i];
+    results[i].pinned = false;
+    results[i].stolen_ns = 0;
+    results[i].machine_wide = 0;
+    results[i].events.reserve(MAX_EVENTS);
+  }
+  TscClock::init(); // calibrate before any thread starts timing
+
+  std::cout << "Host: clock loop on " << cores.size() << " core(s) for "
+            << seconds << " s, gaps of " << threshold << " ns or more"
+            << std::endl;
+  on_every_core(results, [ns, threshold](CoreResult &r, int index) {
+    probe(r, index, ns, threshold);
+  });
+  find_machine_wide(results);
+
+  std::cout << std::left << std::setw(6) << "core" << std::setw(10) << "gaps/s"
+            << std::setw(10) << "stolen%" << std::setw(12) << "p99.99 ns"
+            << std::setw(12) << "max ns" << "machine-wide" << std::endl;
+  BenchReport report("jitter_bench");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const CoreResult &r = results[i];
+    std::ostringstream core;
+    core << r.core << (r.pinned ? "" : "*");
+    double rate = double(r.gaps.count_at_or_above(threshold)) / seconds;
+    std::cout << std::setw(6) << core.str() << std::setw(10) << std::fixed
+              << std::setprecision(1) << rate << std::setw(10)
+              << std::setprecision(3) << 100.0 * double(r.stolen_ns) / double(ns)
+              << std::setw(12) << r.gaps.percentile(99.99) << std::setw(12)
+              << r.gaps.max();
+    if (results.size() > 1) {
+      std::cout << r.machine_wide << " of " << r.events.size();
+    } else {
+      std::cout << "n/a (one core)";
+    }
+    std::cout << std::endl;
+    std::ostringstream name;
+    name << "core" << r.core << "/host/";
+    report.add(name.str() + "gaps_per_s", "1/s", rate);
+    report.add(name.str() + "max_gap", "ns", double(r.gaps.max()));
+  }
+  if (std::find_if(results.begin(), results.end(), [](const CoreResult &r) {
+        return !r.pinned;
+      }) != results.end()) {
+    std::cout << "* could not pin: numbers mix in other cores" << std::endl;
+  }
+
+  std::cout << "\nEngine: one book per core, every operation timed, for "
+            << seconds << " s" << std::endl;
+  on_every_core(results,
+                [ns](CoreResult &r, int) { engine(r, ns); });
+  std::cout << std::setw(6) << "core" << std::setw(12) << "ops/s"
+            << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+            << std::setw(12) << "p99.9 ns" << std::setw(12) << "p99.99 ns"
+            << "max ns" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const CoreResult &r = results[i];
+    std::cout << std::setw(6) << r.core << std::setw(12) << std::setprecision(0)
+              << double(r.ops.count()) / seconds << std::setw(10)
+              << r.ops.percentile(50) << std::setw(10) << r.ops.percentile(99)
+              << std::setw(12) << r.ops.percentile(99.9) << std::setw(12)
+              << r.ops.percentile(99.99) << r.ops.max() << std::endl;
+    std::ostringstream name;
+    name << "core" << r.core << "/engine/";
+    report.add(name.str() + "p99", "ns", double(r.ops.percentile(99)));
+    report.add(name.str() + "p99.9", "ns", double(r.ops.percentile(99.9)));
+  }
+
+  // Host gaps of at least T per second against engine operations of at
+  // least T per second, for T = 1, 2, 5, 10, 20, 50... x threshold
+  std::cout << "\nTail attribution: per second, host gaps >= T vs engine "
+               "operations >= T"
+            << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const CoreResult &r = results[i];
+    std::cout << "core " << r.core << ":" << std::endl;
+    std::cout << "  " << std::setw(12) << "T ns" << std::setw(12) << "host/s"
+              << std::setw(12) << "engine/s" << "explained" << std::endl;
+    uint64_t blame_from = 0; // lowest T from which the host explains most
+    const uint64_t top = std::max(r.gaps.max(), r.ops.max());
+    const uint64_t steps[] = {1, 2, 5};
+    for (uint64_t scale = threshold; scale <= top; scale *= 10) {
+      for (size_t s = 0; s < 3 && scale * steps[s] <= top; ++s) {
+        const uint64_t t = scale * steps[s];
+        double host = double(r.gaps.count_at_or_above(t)) / seconds;
+        double ops = double(r.ops.count_at_or_above(t)) / seconds;
+        if (ops == 0) {
+          continue;
+        }
+        double explained = std::min(1.0, host / ops);
+        std::cout << "  " << std::setw(12) << t << std::setw(12)
+                  << std::setprecision(1) << host << std::setw(12) << ops
+                  << std::setprecision(0) << 100 * explained << "%"
+                  << std::endl;
+        if (explained >= 0.5) {
+          blame_from = blame_from ? blame_from : t;
+        } else {
+          blame_from = 0;
+        }
+      }
+    }
+    if (blame_from != 0) {
+      std::cout << "  => outliers of " << blame_from
+                << " ns and up are mostly the machine: tune the host first"
+                << std::endl;
+    } else {
+      std::cout << "  => the engine's tail is not explained by host gaps"
+                << std::endl;
+    }
+  }
+  report.write();
+  return 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Order Layout (Hot/Cold Split)
+ * ============================================================================
+ *
+ * Runs the same flow through a LevelBook<SimpleOrder *> and a
+ * LevelBook<HotOrder *> (see OrderStore.h):
+ *
+ * - add:    resting orders, many per level, added to the book. add() reads
+ *           each order's side, price, quantity and conditions;
+ * - sweep:  one aggressive IOC order that takes all of them, plus the
+ *           fill callbacks, whose listener reads the side, price and
+ *           quantity of every resting order that filled.
+ *
+ * The orders are created long before they are used, so the caches are
+ * flushed before each phase. They arrive in allocation order
+ * ("sequential") or in a random order ("shuffled", like a queue whose
+ * orders were created at different times).
+ *
+ * A LevelBook keeps open quantities in its own queues and never reads a
+ * resting order while matching, so the layout shows up where orders are
+ * read: on entry and in the listener. A SimpleOrder takes 104 bytes with
+ * its strings' headers, two lines for some orders; a HotOrder takes 20.
+ * With PerfCounters available, each row also shows L1D misses per order.
+ */
+
+#include <BenchReport.h>
+#include <LevelBook.h>
+#include <OrderStore.h>
+#include <PerfCounters.h>
+#include <SimpleOrder.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static const size_t PER_LEVEL = 1000;
+static std::vector<char> flush_buffer(64 << 20);
+
+/// Evict the orders from the caches
+static uint64_t flush_caches() {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < flush_buffer.size(); i += 64) {
+    sum += uint64_t(flush_buffer[i]);
+  }
+  return sum;
+}
+
+/// Reads the matching fields of every resting order that fills
+template <class Order>
+class FillReader : public liquibook::book::OrderListener<Order *> {
+public:
+  FillReader() : sink(0) {}
+  void on_accept(Order *const &) override {}
+  void on_reject(Order *const &, const char *) override {}
+  void on_fill(Order *const &, Order *const &matched,
+               liquibook::book::Quantity qty,
+               liquibook::book::Price) override {
+    sink += matched->is_buy() ? matched->order_qty() - qty
+                              : uint64_t(matched->price());
+  }
+  void on_cancel(Order *const &) override {}
+  void on_cancel_reject(Order *const &, const char *) override {}
+  void on_replace(Order *const &, const int64_t &,
+                  liquibook::book::Price) override {}
+  void on_replace_reject(Order *const &, const char *) override {}
+  uint64_t sink;
+};
+
+/// Medians over the rounds, in ns (and L1D misses, -1 = n/a) per order
+struct Result {
+  double add_ns;
+  double sweep_ns;
+  double add_l1d;
+  double sweep_l1d;
+};
+
+static double median(std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+/**
+ * @param resting     sell orders in arrival order
+ * @param aggressor   a buy for all of them, through every level
+ */
+template <class Order>
+static Result run(const std::vector<Order *> &resting, Order *aggressor,
+                  int rounds, uint64_t &sink) {
+  LevelBook<Order *> book("BENCH");
+  FillReader<Order> reader;
+  book.set_order_listener(&reader);
+  PerfCounters perf;
+  std::vector<double> add_ns, sweep_ns, add_l1d, sweep_l1d;
+  for (int round = 0; round < rounds; ++round) {
+    sink += flush_caches();
+    perf.start();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (size_t i = 0; i < resting.size(); ++i) {
+      book.add(resting[i]);
+    }
+    book.perform_callbacks();
+    std::chrono::steady_clock::time_point stop =
+        std::chrono::steady_clock::now();
+    perf.stop();
+    add_ns.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        double(resting.size()));
+    add_l1d.push_back(double(perf.get(PerfCounters::L1D_MISSES)) /
+                      double(resting.size()));
+
+    sink += flush_caches();
+    perf.start();
+    start = std::chrono::steady_clock::now();
+    book.add(aggressor, liquibook::book::oc_immediate_or_cancel);
+    book.perform_callbacks();
+    stop = std::chrono::steady_clock::now();
+    perf.stop();
+    sweep_ns.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        double(resting.size()));
+    sweep_l1d.push_back(double(perf.get(PerfCounters::L1D_MISSES)) /
+                        double(resting.size()));
+  }
+  sink += reader.sink;
+  const bool counted = perf.available(PerfCounters::L1D_MISSES);
+  Result r = {median(add_ns), median(sweep_ns),
+              counted ? median(add_l1d) : -1, counted ? median(sweep_l1d) : -1};
+  return r;
+}
+
+static void print(const char *layout, const char *pattern, size_t count,
+                  const Result &r, BenchReport &report) {
+  std::cout << std::left << std::setw(13) << layout << std::setw(12)
+            << pattern << std::setw(10) << count << std::fixed
+            << std::setprecision(2) << std::setw(10) << r.add_ns
+            << std::setw(10) << r.sweep_ns;
+  if (r.add_l1d >= 0) {
+    std::cout << std::setw(10) << r.add_l1d << r.sweep_l1d;
+  } else {
+    std::cout << std::setw(10) << "n/a" << "n/a";
+  }
+  std::cout << std::endl;
+  std::ostringstream name;
+  name << layout << "/" << pattern << "/" << count;
+  report.add(name.str() + "/add", "ns", r.add_ns);
+  report.add(name.str() + "/sweep", "ns", r.sweep_ns);
+}
+
+/// Pointers to every order, in allocation order or shuffled
+template <class Order>
+static std::vector<Order *> arrival_order(const std::vector<Order *> &orders,
+                                          bool shuffled) {
+  std::vector<Order *> out(orders);
+  if (shuffled) {
+    uint64_t seed = 7;
+    for (size_t i = out.size(); i > 1; --i) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      std::swap(out[i - 1], out[(seed >> 33) % i]);
+    }
+  }
+  return out;
+}
+
+int main() {
+  const size_t counts[] = {100000, 1000000};
+  BenchReport report("layout_bench");
+  uint64_t sink = 0;
+
+  std::cout << std::left << std::setw(13) << "layout" << std::setw(12)
+            << "pattern" << std::setw(10) << "orders" << std::setw(10)
+            << "add ns" << std::setw(10) << "sweep ns" << std::setw(10)
+            << "add L1D" << "sweep L1D" << std::endl;
+  for (size_t c = 0; c < 2; ++c) {
+    const size_t count = counts[c];
+    const int rounds = count > 100000 ? 5 : 21;
+    const size_t levels = count / PER_LEVEL;
+
+    // Same orders in both layouts: sells, PER_LEVEL to a price
+    std::vector<SimpleOrder> simple;
+    simple.reserve(count + 1);
+    std::vector<SimpleOrder *> simple_ptrs;
+    OrderStore store(count + 1);
+    std::vector<HotOrder *> hot_ptrs;
+    std::streambuf *saved = std::cout.rdbuf(NULL); // SimpleOrder logs
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t qty = uint32_t(1 + i % 5);
+      int32_t price = int32_t(10000 + i % levels);
+      std::ostringstream id;
+      id << "ORDER-" << i;
+      simple.push_back(SimpleOrder(false, qty, price, id.str()));
+      simple_ptrs.push_back(&simple.back());
+      hot_ptrs.push_back(store.add(false, qty, price, id.str()));
+    }
+    simple.push_back(SimpleOrder(true, uint32_t(count * 5),
+                                 int32_t(10000 + levels), "AGGRESSOR"));
+    SimpleOrder *simple_aggressor = &simple.back();
+    HotOrder *hot_aggressor = store.add(true, uint32_t(count * 5),
+                                        int32_t(10000 + levels), "AGGRESSOR");
+    std::cout.rdbuf(saved);
+
+    for (int shuffled = 0; shuffled < 2; ++shuffled) {
+      const char *pattern = shuffled ? "shuffled" : "sequential";
+      Result r = run(arrival_order(simple_ptrs, shuffled != 0),
+                     simple_aggressor, rounds, sink);
+      print("SimpleOrder", pattern, count, r, report);
+      r = run(arrival_order(hot_ptrs, shuffled != 0), hot_aggressor, rounds,
+              sink);
+      print("HotOrder", pattern, count, r, report);
+    }
+  }
+  if (!PerfCounters().any_available()) {
+    std::cout << "(perf counters unavailable here: see PerfCounters.h)"
+              << std::endl;
+  }
+  if (sink == 42) {
+    std::cout << "";
+  }
+  report.write();
+  return 0;
+}
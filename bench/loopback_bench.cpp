@@ -0,0 +1,359 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Tick-to-Trade over Loopback
+ * ============================================================================
+ *
+ * End-to-end latency through the whole engine, not just LevelBook::add():
+ *
+ *   client --TCP--> engine thread: socket read, OrderGateway::submit(),
+ *                   process(), LevelBook::add(), perform_callbacks()
+ *          <--TCP-- acks and fills written back by the listener
+ *
+ * The client sends orders at a fixed offered rate and times the ack and
+ * the fill of every order. Orders alternate buy/sell at one price, so
+ * every second order trades against the one before it.
+ *
+ * Coordinated omission: a tester that waits before sending the next
+ * order stops sending exactly when the engine is slow, so the slow
+ * periods are barely sampled. Here every order has an intended send time
+ * on a fixed schedule, and latency is measured from that time. If the
+ * engine (or the client) falls behind, the orders that should have gone
+ * out meanwhile are charged for the wait. "raw" latency, measured from
+ * the actual send, is printed next to it to show the difference.
+ *
+ * Each offered rate gets one line of percentiles, and its corrected ack
+ * histogram is written to loopback_<rate>.hgrm. Where p99 turns sharply
+ * upward as the rate rises is the knee: the engine's usable capacity.
+ *
+ * Usage: loopback_bench [seconds per rate]   (POSIX sockets)
+ */
+
+#include <BenchReport.h>
+#include <LatencyHistogram.h>
+#include <LevelBook.h>
+#include <OrderGateway.h>
+#include <SimpleOrder.h>
+#include <TscClock.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef LevelBook<SimpleOrder *> Book;
+
+/// Client -> engine: submit pool order `index`
+struct Request {
+  uint32_t index;
+};
+
+static const uint32_t STOP = ~uint32_t(0);
+
+/// Engine -> client
+struct Response {
+  uint32_t index;
+  uint32_t type;
+};
+
+enum {
+  ACK,
+  FILL,         // the incoming order traded: tick-to-trade
+  PASSIVE_FILL, // the resting order it traded with
+  REJECT
+};
+
+static void send_all(int fd, const char *data, size_t size) {
+  while (size != 0) {
+    ssize_t sent = send(fd, data, size, 0);
+    if (sent < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      std::perror("send");
+      std::exit(1);
+    }
+    data += sent;
+    size -= size_t(sent);
+  }
+}
+
+static void no_delay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/**
+ * The engine side: book + gateway on one thread, answering over TCP.
+ */
+class Engine : public liquibook::book::OrderListener<SimpleOrder *> {
+public:
+  explicit Engine(std::vector<SimpleOrder> &pool)
+      : pool_(pool), gateway_(book_, *this), fd_(-1) {
+    book_.set_order_listener(&gateway_); // it passes events on to us
+    out_.reserve(1 << 16);
+  }
+
+  /// Serve one connection until the client sends STOP
+  void serve(int fd, uint32_t session) {
+    fd_ = fd;
+    gateway_.open_session(session);
+    std::vector<char> in(1 << 16);
+    size_t have = 0;
+    for (;;) {
+      ssize_t got = recv(fd, &in[have], in.size() - have, 0);
+      if (got <= 0) {
+        break;
+      }
+      have += size_t(got);
+      size_t used = 0;
+      bool stop = false;
+      for (; used + sizeof(Request) <= have; used += sizeof(Request)) {
+        Request req;
+        std::memcpy(&req, &in[used], sizeof(req));
+        if (req.index == STOP) {
+          stop = true;
+          break;
+        }
+        gateway_.submit(session, &pool_[req.index]);
+      }
+      gateway_.process();
+      book_.perform_callbacks();
+      flush();
+      std::memmove(&in[0], &in[used], have - used);
+      have -= used;
+      if (stop) {
+        break;
+      }
+    }
+    gateway_.close_session(session);
+  }
+
+  void on_accept(SimpleOrder *const &order) override { reply(order, ACK); }
+  void on_reject(SimpleOrder *const &order, const char *) override {
+    reply(order, REJECT);
+  }
+  void on_fill(SimpleOrder *const &order, SimpleOrder *const &matched,
+               liquibook::book::Quantity, liquibook::book::Price) override {
+    // Equal sizes: both orders are done
+    reply(order, FILL);
+    reply(matched, PASSIVE_FILL);
+  }
+  void on_cancel(SimpleOrder *const &) override {}
+  void on_cancel_reject(SimpleOrder *const &, const char *) override {}
+  void on_replace(SimpleOrder *const &, const int64_t &,
+                  liquibook::book::Price) override {}
+  void on_replace_reject(SimpleOrder *const &, const char *) override {}
+
+private:
+  void reply(SimpleOrder *order, uint32_t type) {
+    Response r;
+    r.index = uint32_t(order - &pool_[0]);
+    r.type = type;
+    const char *bytes = reinterpret_cast<const char *>(&r);
+    out_.insert(out_.end(), bytes, bytes + sizeof(r));
+  }
+
+  void flush() {
+    if (!out_.empty()) {
+      send_all(fd_, &out_[0], out_.size());
+      out_.clear();
+    }
+  }
+
+  std::vector<SimpleOrder> &pool_;
+  Book book_;
+  OrderGateway<Book> gateway_;
+  int fd_;
+  std::vector<char> out_;
+};
+
+struct Result {
+  LatencyHistogram ack;     // from intended send time
+  LatencyHistogram fill;    // incoming order's fill, from intended send
+  LatencyHistogram ack_raw; // from actual send time
+  uint64_t sent;
+  double seconds;
+};
+
+/**
+ * Offer `count` orders at `rate` per second on a fixed schedule and wait
+ * for every ack and fill.
+ */
+static void offer(int fd, uint64_t rate, uint32_t count, Result &result) {
+  const uint64_t interval = 1000000000ULL / rate;
+  std::vector<uint64_t> sent_at(count);
+  std::vector<char> in(1 << 16);
+  size_t have = 0;
+  std::vector<char> out; // requests the socket didn't take yet
+  uint32_t next = 0;
+  uint32_t fills = 0;
+  uint32_t acks = 0;
+
+  const uint64_t start = TscClock::now() + 1000000; // first send in 1 ms
+  while (acks < count || fills < count) {
+    uint64_t now = TscClock::now();
+    // Send everything that is due; if we fell behind, catch up at once.
+    // Never block on send: the engine may be blocked sending to us.
+    while (next < count && now >= start + next * interval) {
+      Request req;
+      req.index = next;
+      sent_at[next] = now;
+      const char *bytes = reinterpret_cast<const char *>(&req);
+      out.insert(out.end(), bytes, bytes + sizeof(req));
+      ++next;
+    }
+    if (!out.empty()) {
+      ssize_t sent = send(fd, &out[0], out.size(), MSG_DONTWAIT);
+      if (sent > 0) {
+        out.erase(out.begin(), out.begin() + sent);
+      }
+    }
+    ssize_t got = recv(fd, &in[have], in.size() - have, MSG_DONTWAIT);
+    if (got <= 0) {
+      std::this_thread::yield(); // let the engine run on a shared core
+      continue;
+    }
+    have += size_t(got);
+    now = TscClock::now();
+    size_t used = 0;
+    for (; used + sizeof(Response) <= have; used += sizeof(Response)) {
+      Response r;
+      std::memcpy(&r, &in[used], sizeof(r));
+      uint64_t intended = start + r.index * interval;
+      if (r.type == FILL) {
+        result.fill.record(now - intended);
+        ++fills;
+      } else if (r.type == PASSIVE_FILL) {
+        ++fills; // timed by the order that took it
+      } else {
+        result.ack.record(now - intended);
+        result.ack_raw.record(now - sent_at[r.index]);
+        ++acks;
+        if (r.type == REJECT) {
+          ++fills; // never fills
+        }
+      }
+    }
+    std::memmove(&in[0], &in[used], have - used);
+    have -= used;
+  }
+  result.sent = count;
+  result.seconds = double(TscClock::now() - start) / 1e9;
+}
+
+static void us(std::ostream &out, uint64_t ns) {
+  out << std::setw(10) << std::fixed << std::setprecision(1) << ns / 1000.0;
+}
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 1.0;
+  const uint64_t rates[] = {10000, 50000, 100000, 200000, 400000};
+  const size_t rate_count = sizeof(rates) / sizeof(rates[0]);
+  const uint32_t max_orders = uint32_t(rates[rate_count - 1] * seconds);
+
+  // One order object per message; SimpleOrder logs when constructed, so
+  // build the pool with std::cout muted
+  std::vector<SimpleOrder> pool;
+  pool.reserve(max_orders);
+  std::streambuf *saved = std::cout.rdbuf(NULL);
+  for (uint32_t i = 0; i < max_orders; ++i) {
+    std::ostringstream id;
+    id << "L" << i;
+    pool.push_back(SimpleOrder(i % 2 == 0, 100, 10000, id.str()));
+  }
+  std::cout.rdbuf(saved);
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+    std::perror("listen");
+    return 1;
+  }
+
+  Engine engine(pool);
+  std::thread engine_thread([&] {
+    for (size_t r = 0; r <= rate_count; ++r) { // +1: warm-up run
+      int fd = accept(listener, NULL, NULL);
+      no_delay(fd);
+      engine.serve(fd, uint32_t(r + 1));
+      close(fd);
+    }
+  });
+
+  BenchReport report("loopback_bench");
+  std::cout << "Latency in us, measured from each order's intended send "
+               "time (raw = from the actual send)"
+            << std::endl;
+  std::cout << std::left << std::setw(10) << "offered" << std::right
+            << std::setw(10) << "achieved" << std::setw(10) << "ack p50"
+            << std::setw(10) << "ack p99" << std::setw(10) << "ack p99.9"
+            << std::setw(10) << "ack max" << std::setw(10) << "fill p99"
+            << std::setw(10) << "raw p99" << std::endl;
+
+  for (size_t r = 0; r <= rate_count; ++r) {
+    const bool warm_up = r == 0;
+    const uint64_t rate = warm_up ? rates[0] : rates[r - 1];
+    const uint32_t count =
+        std::min(max_orders, uint32_t(rate * (warm_up ? 0.2 : seconds))) & ~1u;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+      std::perror("connect");
+      return 1;
+    }
+    no_delay(fd);
+    Result result;
+    offer(fd, rate, count, result);
+    Request stop;
+    stop.index = STOP;
+    send_all(fd, reinterpret_cast<const char *>(&stop), sizeof(stop));
+    close(fd);
+    if (warm_up) {
+      continue;
+    }
+
+    std::cout << std::left << std::setw(10) << rate << std::right
+              << std::setw(10) << uint64_t(result.sent / result.seconds);
+    us(std::cout, result.ack.percentile(50));
+    us(std::cout, result.ack.percentile(99));
+    us(std::cout, result.ack.percentile(99.9));
+    us(std::cout, result.ack.max());
+    us(std::cout, result.fill.percentile(99));
+    us(std::cout, result.ack_raw.percentile(99));
+    std::cout << std::endl;
+
+    std::ostringstream prefix;
+    prefix << "rate" << rate << "/ack";
+    report.add(prefix.str() + "/p50", "ns", double(result.ack.percentile(50)));
+    report.add(prefix.str() + "/p99", "ns", double(result.ack.percentile(99)));
+    report.add(prefix.str() + "/p99.9", "ns",
+               double(result.ack.percentile(99.9)));
+
+    std::ostringstream name;
+    name << "loopback_" << rate << ".hgrm";
+    std::ofstream hgrm(name.str().c_str());
+    result.ack.print(hgrm, 1000.0);
+  }
+
+  report.write();
+  engine_thread.join();
+  close(listener);
+  return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Matching Policies
+ * ============================================================================
+ *
+ * Times one aggressive order against a single price level of N resting
+ * orders, under each LevelBook matching policy. The aggressor takes a third
+ * of the level, so pro-rata touches every order while FIFO stops early.
+ *
+ * Only the add() of the aggressive order is timed; building and clearing
+ * the level happens outside the timed region.
+ */
+
+#include <BenchReport.h>
+#include <LevelBook.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "BenchOrder.h"
+
+static const char *policy_name(MatchPolicy policy) {
+  switch (policy) {
+  case MATCH_FIFO:
+    return "FIFO";
+  case MATCH_PRO_RATA:
+    return "PRO_RATA";
+  case MATCH_PRO_RATA_TOP_ORDER:
+    return "PRO_RATA_TOP";
+  }
+  return "?";
+}
+
+/**
+ * @param samples  receives nanoseconds for each aggressive order
+ * @return median nanoseconds per aggressive order
+ */
+static double run(MatchPolicy policy, size_t depth, int rounds,
+                  std::vector<double> &samples) {
+  LevelBook<BenchOrder *> book("BENCH", policy);
+  std::vector<BenchOrder> resting(depth);
+  samples.clear();
+  samples.reserve(rounds);
+
+  uint64_t seed = 42;
+  for (int round = 0; round < rounds; ++round) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < depth; ++i) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      resting[i].buy = false;
+      resting[i].qty = uint32_t(1 + (seed >> 33) % 100);
+      resting[i].px = 10000;
+      total += resting[i].qty;
+      book.add(&resting[i]);
+    }
+    book.perform_callbacks();
+
+    BenchOrder aggressor = {true, uint32_t(total / 3), 10000, false};
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    book.add(&aggressor, liquibook::book::oc_immediate_or_cancel);
+    std::chrono::steady_clock::time_point stop =
+        std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count());
+
+    for (size_t i = 0; i < depth; ++i) {
+      book.cancel(&resting[i]); // filled ones just get a cancel reject
+    }
+    book.perform_callbacks();
+  }
+
+  std::vector<double> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[sorted.size() / 2];
+}
+
+int main() {
+  const MatchPolicy policies[] = {MATCH_FIFO, MATCH_PRO_RATA,
+                                  MATCH_PRO_RATA_TOP_ORDER};
+  const size_t depths[] = {10, 100, 1000, 10000};
+  BenchReport report("match_bench");
+  std::vector<double> samples;
+
+  std::cout << std::left << std::setw(14) << "policy" << std::setw(10)
+            << "orders" << std::setw(14) << "ns/match" << "ns/order"
+            << std::endl;
+  for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+    for (size_t p = 0; p < 3; ++p) {
+      double ns = run(policies[p], depths[d], depths[d] >= 10000 ? 51 : 501,
+                      samples);
+      std::ostringstream name;
+      name << policy_name(policies[p]) << "/" << depths[d];
+      report.add(name.str(), "ns", samples);
+      std::cout << std::left << std::setw(14) << policy_name(policies[p])
+                << std::setw(10) << depths[d] << std::setw(14) << std::fixed
+                << std::setprecision(0) << ns << std::setprecision(2)
+                << ns / depths[d] << std::endl;
+    }
+  }
+  report.write();
+  return 0;
+}
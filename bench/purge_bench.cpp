@@ -0,0 +1,104 @@
+/**
+ * ============================================================================
+ * BENCHMARK: End-of-Session Purge
+ * ============================================================================
+ *
+ * Fills a LevelBook with N resting orders spread over 1,000 price levels
+ * per side, then times purge_day_orders() and the delivery of the cancel
+ * reports to a listener that just counts them.
+ *
+ * Run once with only DAY orders (the levels are dropped whole) and once
+ * with 1% GTC orders (each level is filtered and the GTC orders kept).
+ *
+ * Usage: purge_bench [orders]   (default 10,000,000)
+ */
+
+#include <BenchReport.h>
+#include <LevelBook.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "BenchOrder.h"
+
+/// Counts cancel reports, ignores everything else
+class CountingListener : public liquibook::book::OrderListener<BenchOrder *> {
+public:
+  CountingListener() : canceled(0) {}
+  void on_accept(BenchOrder *const &) override {}
+  void on_reject(BenchOrder *const &, const char *) override {}
+  void on_fill(BenchOrder *const &, BenchOrder *const &, liquibook::book::Quantity,
+               liquibook::book::Price) override {}
+  void on_cancel(BenchOrder *const &) override { ++canceled; }
+  void on_cancel_reject(BenchOrder *const &, const char *) override {}
+  void on_replace(BenchOrder *const &, const int64_t &,
+                  liquibook::book::Price) override {}
+  void on_replace_reject(BenchOrder *const &, const char *) override {}
+
+  size_t canceled;
+};
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static void run(size_t count, unsigned gtc_percent, BenchReport &report) {
+  const int32_t levels = 1000;
+  std::vector<BenchOrder> orders(count);
+  CountingListener listener;
+  LevelBook<BenchOrder *> book("BENCH");
+  book.set_order_listener(&listener);
+
+  // Bids at 9000..9999, asks at 10000..10999: nothing crosses
+  for (size_t i = 0; i < count; ++i) {
+    BenchOrder &order = orders[i];
+    order.buy = (i & 1) == 0;
+    order.qty = 100;
+    int32_t offset = int32_t((i >> 1) % levels);
+    order.px = order.buy ? 9999 - offset : 10000 + offset;
+    order.gtc = (i % 100) < gtc_percent;
+    book.add(&order);
+  }
+  book.perform_callbacks();
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  size_t purged = book.purge_day_orders();
+  double purge_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  book.perform_callbacks();
+  double report_ms = ms_since(start);
+
+  std::cout << std::left << std::setw(12) << count << std::setw(8)
+            << gtc_percent << std::setw(12) << purged << std::setw(12)
+            << std::fixed << std::setprecision(1) << purge_ms << std::setw(12)
+            << report_ms << book.resting_count() << std::endl;
+  std::ostringstream name;
+  name << count << "/gtc" << gtc_percent;
+  report.add(name.str() + "/purge", "ms", purge_ms);
+  report.add(name.str() + "/report", "ms", report_ms);
+  if (listener.canceled != purged) {
+    std::cout << "  cancel reports: " << listener.canceled << std::endl;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 10000000;
+
+  std::cout << std::left << std::setw(12) << "orders" << std::setw(8)
+            << "gtc%" << std::setw(12) << "purged" << std::setw(12)
+            << "purge ms" << std::setw(12) << "report ms" << "left"
+            << std::endl;
+  BenchReport report("purge_bench");
+  run(count, 0, report);
+  run(count, 1, report);
+  report.write();
+  return 0;
+}
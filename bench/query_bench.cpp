@@ -0,0 +1,84 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Cost-to-Fill Queries
+ * ============================================================================
+ *
+ * Publishes a DepthSnapshot of a book with N ask levels, then times
+ * cost_to_fill() for order sizes spread across the whole depth, as a
+ * reader thread would run it. Only the queries are timed.
+ */
+
+#include <BenchReport.h>
+#include <DepthSnapshot.h>
+#include <LevelBook.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "BenchOrder.h"
+
+/**
+ * @param samples  receives nanoseconds per query for each of `chunks`
+ *                 equal runs of the queries
+ * @return median nanoseconds per query
+ */
+static double run(size_t levels, int queries, int chunks,
+                  std::vector<double> &samples) {
+  LevelBook<BenchOrder *> book("BENCH");
+  std::vector<BenchOrder> resting(levels);
+  uint64_t total = 0;
+  for (size_t i = 0; i < levels; ++i) {
+    resting[i].buy = false;
+    resting[i].qty = uint32_t(100 + (i * 37) % 900);
+    resting[i].px = int32_t(10000 + i);
+    total += resting[i].qty;
+    book.add(&resting[i]);
+  }
+  book.perform_callbacks();
+
+  SnapshotPublisher publisher;
+  publisher.publish(book);
+  SnapshotPublisher::Ptr snapshot = publisher.current();
+
+  uint64_t sink = 0;
+  const int per_chunk = queries / chunks;
+  samples.clear();
+  for (int c = 0; c < chunks; ++c) {
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int i = c * per_chunk; i < (c + 1) * per_chunk; ++i) {
+      uint64_t qty = 1 + (uint64_t(i) * 7919) % total;
+      sink += snapshot->cost_to_fill(DepthSnapshot::ASK, qty).cost;
+    }
+    std::chrono::steady_clock::time_point stop =
+        std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        per_chunk);
+  }
+  if (sink == 42) {
+    std::cout << ""; // keep the loop from being optimized away
+  }
+  std::vector<double> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[sorted.size() / 2];
+}
+
+int main() {
+  const size_t depths[] = {10, 100, 1000, 10000};
+  BenchReport report("query_bench");
+  std::vector<double> samples;
+  std::cout << std::left << std::setw(10) << "levels" << "ns/query"
+            << std::endl;
+  for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+    std::cout << std::left << std::setw(10) << depths[d] << std::fixed
+              << std::setprecision(1) << run(depths[d], 1000000, 20, samples)
+              << std::endl;
+    report.add("levels/" + std::to_string(depths[d]), "ns", samples);
+  }
+  report.write();
+  return 0;
+}
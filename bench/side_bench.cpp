@@ -0,0 +1,153 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Side Branches
+ * ============================================================================
+ *
+ * Runs a mixed flow through a LevelBook (passive orders resting near the
+ * mid, aggressive IOC orders sweeping one to five levels, cancels of the
+ * oldest resting order) and reports time, instructions and branch misses
+ * per operation.
+ *
+ * The side of each order is drawn two ways:
+ *
+ * - random:  a coin flip per order, which the CPU can't predict;
+ * - runs:    64 buys, then 64 sells, and so on, which it can.
+ *
+ * A book that tests is_buy() inside its match loop mispredicts on random
+ * sides at every level it visits; one that picks per-side code once, at
+ * entry (see BidSide in LevelBook.h), only at entry. The gap between the
+ * two rows is what side branches still cost.
+ *
+ * To measure the change itself, build this file against an older
+ * include/LevelBook.h as well, run both with BENCH_JSON set and compare
+ * them with bench_compare. Branch misses need PerfCounters (Linux, and
+ * not every VM).
+ */
+
+#include <BenchReport.h>
+#include <LevelBook.h>
+#include <PerfCounters.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "BenchOrder.h"
+
+class Flow {
+public:
+  static const size_t RESTING = 2000; // passive orders kept in the book
+  static const int32_t MID = 10000;
+
+  explicit Flow(bool random_sides)
+      : random_sides_(random_sides), book_("BENCH"), resting_(RESTING),
+        next_(0), seed_(42), op_(0) {
+    for (size_t i = 0; i < RESTING; ++i) {
+      resting_[i].qty = 0; // 0 = slot never used
+    }
+  }
+
+  /// One operation: a cancel and a passive add, or an aggressive IOC
+  void step() {
+    uint64_t r = next_random();
+    bool buy = random_sides_ ? (r >> 40) & 1 : (op_ >> 6) & 1;
+    ++op_;
+    int32_t offset = int32_t(1 + (r >> 20) % 5);
+    if ((r >> 8) % 10 < 3) {
+      BenchOrder aggressor = {buy, uint32_t(1 + (r >> 44) % 200),
+                              buy ? MID + offset : MID - offset, false};
+      book_.add(&aggressor, liquibook::book::oc_immediate_or_cancel);
+    } else {
+      BenchOrder &order = resting_[next_];
+      next_ = (next_ + 1) % RESTING;
+      if (order.qty != 0) {
+        book_.cancel(&order); // a filled one just gets a cancel reject
+      }
+      order.buy = buy;
+      order.qty = uint32_t(1 + (r >> 44) % 100);
+      order.px = buy ? MID - offset + 1 : MID + offset - 1;
+      book_.add(&order);
+    }
+    book_.perform_callbacks();
+  }
+
+private:
+  uint64_t next_random() {
+    seed_ = seed_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed_;
+  }
+
+  bool random_sides_;
+  LevelBook<BenchOrder *> book_;
+  std::vector<BenchOrder> resting_;
+  size_t next_;
+  uint64_t seed_;
+  uint64_t op_;
+};
+
+int main() {
+  const size_t warmup = 200000;
+  const size_t chunks = 200;
+  const size_t chunk = 5000;
+  BenchReport report("side_bench");
+
+  std::cout << std::left << std::setw(10) << "sides" << std::setw(12)
+            << "ns/op" << std::setw(14) << "instr/op" << "branch miss/op"
+            << std::endl;
+  for (int random_sides = 1; random_sides >= 0; --random_sides) {
+    const char *name = random_sides ? "random" : "runs";
+    Flow flow(random_sides != 0);
+    for (size_t i = 0; i < warmup; ++i) {
+      flow.step();
+    }
+
+    PerfCounters perf;
+    std::vector<double> samples; // ns/op of each chunk
+    uint64_t instructions = 0, branch_misses = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+      perf.start();
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      for (size_t i = 0; i < chunk; ++i) {
+        flow.step();
+      }
+      std::chrono::steady_clock::time_point stop =
+          std::chrono::steady_clock::now();
+      perf.stop();
+      samples.push_back(
+          std::chrono::duration<double, std::nano>(stop - start).count() /
+          double(chunk));
+      instructions += perf.get(PerfCounters::INSTRUCTIONS);
+      branch_misses += perf.get(PerfCounters::BRANCH_MISSES);
+    }
+    report.add(std::string(name) + "/ns", "ns", samples);
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    const double ops = double(chunks * chunk);
+    std::cout << std::left << std::setw(10) << name << std::setw(12)
+              << std::fixed << std::setprecision(1)
+              << sorted[sorted.size() / 2];
+    if (perf.available(PerfCounters::INSTRUCTIONS)) {
+      std::cout << std::setw(14) << double(instructions) / ops;
+    } else {
+      std::cout << std::setw(14) << "n/a";
+    }
+    if (perf.available(PerfCounters::BRANCH_MISSES)) {
+      std::cout << std::setprecision(3) << double(branch_misses) / ops;
+      report.add(std::string(name) + "/branch-misses", "misses/op",
+                 double(branch_misses) / ops);
+    } else {
+      std::cout << "n/a";
+    }
+    std::cout << std::endl;
+  }
+  if (!PerfCounters().any_available()) {
+    std::cout << "(perf counters unavailable here: see PerfCounters.h)"
+              << std::endl;
+  }
+  report.write();
+  return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * ============================================================================
+ * BENCHMARK: Deep Level Sweeps
+ * ============================================================================
+ *
+ * Times one aggressive order sweeping levels made of thousands of small
+ * (1 lot) resting orders, with LevelBook's prefetching off and on (see
+ * LevelBook::set_prefetch_distance()).
+ *
+ * Every order that fills is removed from the book's order index, at an
+ * address that depends on the order, not on its place in the queue. The
+ * book also holds a large "background" of orders on other levels, so the
+ * index is much bigger than the cache, and the caches are flushed before
+ * each sweep: the resting orders arrived long before the aggressor, so
+ * their index entries are no longer cached.
+ *
+ * Only the add() of the aggressive order is timed. To see what batching
+ * the index cleanup itself is worth, run this file against an older
+ * include/LevelBook.h too and compare with bench_compare.
+ */
+
+#include <BenchReport.h>
+#include <LevelBook.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "BenchOrder.h"
+
+static const size_t BACKGROUND = 500000; // resting orders not swept
+static std::vector<char> flush_buffer(64 << 20);
+
+/// Evict the book from the caches
+static uint64_t flush_caches() {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < flush_buffer.size(); i += 64) {
+    sum += uint64_t(flush_buffer[i]);
+  }
+  return sum;
+}
+
+/**
+ * @param samples  receives nanoseconds per swept order, one per round
+ * @return median nanoseconds per swept order
+ */
+static double run(size_t levels, size_t per_level, size_t distance,
+                  int rounds, std::vector<double> &samples) {
+  LevelBook<BenchOrder *> book("BENCH");
+  book.set_prefetch_distance(distance);
+
+  // Background: buys far from the swept asks, so the index is large
+  std::vector<BenchOrder> background(BACKGROUND);
+  for (size_t i = 0; i < BACKGROUND; ++i) {
+    background[i].buy = true;
+    background[i].qty = 1;
+    background[i].px = int32_t(5000 - i % 1000);
+    book.add(&background[i]);
+  }
+  book.perform_callbacks();
+
+  std::vector<BenchOrder> resting(levels * per_level);
+  samples.clear();
+  uint64_t sink = 0;
+  for (int round = 0; round < rounds; ++round) {
+    for (size_t i = 0; i < resting.size(); ++i) {
+      resting[i].buy = false;
+      resting[i].qty = 1;
+      resting[i].px = int32_t(10000 + i / per_level);
+      book.add(&resting[i]);
+    }
+    book.perform_callbacks();
+    sink += flush_caches();
+
+    BenchOrder aggressor = {true, uint32_t(resting.size()),
+                            int32_t(10000 + levels), false};
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    book.add(&aggressor, liquibook::book::oc_immediate_or_cancel);
+    std::chrono::steady_clock::time_point stop =
+        std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        double(resting.size()));
+    book.perform_callbacks();
+  }
+  if (sink == 42) {
+    std::cout << "";
+  }
+
+  std::vector<double> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[sorted.size() / 2];
+}
+
+int main() {
+  struct Shape {
+    size_t levels;
+    size_t per_level;
+  };
+  const Shape shapes[] = {{1, 1000}, {1, 5000}, {10, 1000}, {4, 5000}};
+  const size_t distances[] = {0, 8};
+  BenchReport report("sweep_bench");
+  std::vector<double> samples;
+
+  std::cout << std::left << std::setw(8) << "levels" << std::setw(12)
+            << "orders/lvl" << std::setw(10) << "prefetch" << "ns/order"
+            << std::endl;
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    for (size_t d = 0; d < 2; ++d) {
+      double ns = run(shapes[s].levels, shapes[s].per_level, distances[d], 61,
+                      samples);
+      std::ostringstream name;
+      name << shapes[s].levels << "x" << shapes[s].per_level << "/prefetch-"
+           << distances[d];
+      report.add(name.str(), "ns", samples);
+      std::cout << std::left << std::setw(8) << shapes[s].levels
+                << std::setw(12) << shapes[s].per_level << std::setw(10)
+                << distances[d] << std::fixed << std::setprecision(1) << ns
+                << std::endl;
+    }
+  }
+  report.write();
+  return 0;
+}
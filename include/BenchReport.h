@@ -0,0 +1,165 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_BENCH_CONFIG
+#include <bench_config.h> // generated by CMake at build time
+#endif
+#ifndef BENCH_GIT_HASH
+#define BENCH_GIT_HASH "unknown"
+#endif
+#ifndef BENCH_CXX_FLAGS
+#define BENCH_CXX_FLAGS "unknown"
+#endif
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "unknown"
+#endif
+
+/**
+ * ============================================================================
+ * CLASS: BenchReport
+ * ============================================================================
+ * Saves a benchmark's results in a machine-readable file, so runs can be
+ * compared later (see bench_compare) instead of vanishing with the
+ * terminal.
+ *
+ * Each benchmark adds its measurements - every repetition, not just the
+ * median - and write() appends them to the file named by the BENCH_JSON
+ * environment variable, one JSON object per line:
+ *
+ *   {"bench":"match_bench","name":"FIFO/1000","unit":"ns","samples":[...],
+ *    "env":{"git":"1a2b3c4","cpu":"...","cores":8,"compiler":"...",
+ *           "flags":"-O3 ...","build":"Release","time":"2026-..."}}
+ *
+ * Running a benchmark several times with the same BENCH_JSON adds more
+ * repetitions. Without BENCH_JSON nothing is written.
+ *
+ * Every unit is lower-is-better (times, latencies).
+ */
+class BenchReport {
+public:
+  /// @param bench  benchmark program name
+  explicit BenchReport(const std::string &bench) : bench_(bench) {}
+
+  /**
+   * @param name     what was measured, e.g. "FIFO/1000"
+   * @param unit     e.g. "ns" or "us"
+   * @param samples  one value per repetition
+   */
+  void add(const std::string &name, const std::string &unit,
+           const std::vector<double> &samples) {
+    Entry entry;
+    entry.name = name;
+    entry.unit = unit;
+    entry.samples = samples;
+    entries_.push_back(entry);
+  }
+
+  /// A measurement with a single repetition
+  void add(const std::string &name, const std::string &unit, double value) {
+    add(name, unit, std::vector<double>(1, value));
+  }
+
+  /// Append the results to $BENCH_JSON
+  /// @return false if BENCH_JSON is unset or can't be written
+  bool write() const {
+    const char *path = std::getenv("BENCH_JSON");
+    if (path == NULL || *path == '\0') {
+      return false;
+    }
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+      return false;
+    }
+    const std::string env = environment();
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const Entry &e = entries_[i];
+      out << "{\"bench\":" << quote(bench_) << ",\"name\":" << quote(e.name)
+          << ",\"unit\":" << quote(e.unit) << ",\"samples\":[";
+      out << std::setprecision(9);
+      for (size_t s = 0; s < e.samples.size(); ++s) {
+        out << (s ? "," : "") << e.samples[s];
+      }
+      out << "],\"env\":" << env << "}\n";
+    }
+    return bool(out);
+  }
+
+private:
+  struct Entry {
+    std::string name;
+    std::string unit;
+    std::vector<double> samples;
+  };
+
+  static std::string environment() {
+    std::ostringstream env;
+    env << "{\"git\":" << quote(BENCH_GIT_HASH) << ",\"cpu\":" << quote(cpu())
+        << ",\"cores\":" << std::thread::hardware_concurrency()
+        << ",\"compiler\":" << quote(compiler())
+        << ",\"flags\":" << quote(BENCH_CXX_FLAGS)
+        << ",\"build\":" << quote(BENCH_BUILD_TYPE)
+        << ",\"time\":" << quote(now()) << "}";
+    return env.str();
+  }
+
+  /// CPU model from /proc/cpuinfo (Linux), else "unknown"
+  static std::string cpu() {
+    std::ifstream info("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(info, line)) {
+      if (line.compare(0, 10, "model name") == 0) {
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+          return line.substr(line.find_first_not_of(' ', colon + 1));
+        }
+      }
+    }
+    return "unknown";
+  }
+
+  static std::string compiler() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#else
+    return "unknown";
+#endif
+  }
+
+  static std::string now() {
+    char text[32];
+    std::time_t t = std::time(NULL);
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+    return text;
+  }
+
+  static std::string quote(const std::string &text) {
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+      char c = text[i];
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+    return out + "\"";
+  }
+
+  std::string bench_;
+  std::vector<Entry> entries_;
+};
@@ -0,0 +1,299 @@
+#pragma once
+#include <TscClock.h>
+#include <book/order_listener.h>
+#include <book/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Where and when a book event happened, for latency analysis and audit.
+ *
+ *   ingress_ns - when the request entered the engine (the gateway's clock
+ *                read; 0 if the request didn't come through a gateway)
+ *   match_ns   - when the book started producing the request's events
+ *   sequence   - event number, gap-free per shard (per book if the book
+ *                isn't managed by a BookManager)
+ *   shard      - shard that owns the book
+ *
+ * match_ns - ingress_ns is the time spent queued and waiting for the
+ * matching thread; a receiver that stamps its own arrival time gets the
+ * rest of tick-to-trade without reading any clock in the engine again.
+ * The two are read on different threads, and TscClock is only monotonic
+ * per thread, so match_ns is clamped to at least ingress_ns: a queue
+ * time of a few ticks below zero reads as 0, never as a huge unsigned
+ * value.
+ */
+struct EventEnvelope {
+  uint64_t ingress_ns = 0;
+  uint64_t match_ns = 0;
+  uint64_t sequence = 0;
+  uint32_t shard = 0;
+};
+
+template <class OrderPtr> class CallbackQueue;
+
+/**
+ * An OrderListener that can also see each event's EventEnvelope.
+ *
+ * Pass one to a book's set_order_listener() and the book starts stamping
+ * its events; inside any callback, envelope() describes the event being
+ * delivered. Books given a plain OrderListener don't stamp anything.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr>
+class EnvelopeListener : public liquibook::book::OrderListener<OrderPtr> {
+public:
+  /// @return the envelope of the event being delivered
+  const EventEnvelope &envelope() const { return envelope_; }
+
+  /// Hand the current envelope to `next`, for a listener that passes
+  /// events on to another EnvelopeListener
+  void forward_envelope(EnvelopeListener &next) const {
+    next.envelope_ = envelope_;
+  }
+
+private:
+  friend class CallbackQueue<OrderPtr>;
+  EventEnvelope envelope_;
+};
+
+/**
+ * ============================================================================
+ * CLASS: CallbackQueue
+ * ============================================================================
+ * Order events waiting to be delivered to an OrderListener.
+ *
+ * Like Liquibook, our books never call the listener in the middle of
+ * matching. Events are queued while the book changes and delivered together
+ * by perform(), so a listener always sees a consistent book.
+ *
+ * Envelopes: when stamping is on (set_envelope_listener()), the first
+ * event of each operation records one stamp - ingress time, one clock
+ * read, first sequence number - and the operation's other events share
+ * it, numbered consecutively. Stamps live in a vector that is cleared,
+ * not freed, after each perform(), so stamping doesn't allocate once
+ * warm. end_operation() marks where the next operation starts.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr> class CallbackQueue {
+public:
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef liquibook::book::OrderListener<OrderPtr> TypedOrderListener;
+  typedef EnvelopeListener<OrderPtr> TypedEnvelopeListener;
+
+  CallbackQueue()
+      : envelopes_(NULL), stamped_(false), ingress_ns_(0), shard_(0),
+        own_sequence_(0), sequence_(NULL) {}
+
+  /// Stamp events for `listener` (NULL = stop stamping)
+  void set_envelope_listener(TypedEnvelopeListener *listener) {
+    envelopes_ = listener;
+    if (listener != NULL) {
+      TscClock::init(); // not on the first stamped event
+    }
+  }
+
+  /**
+   * @param shard     shard ID written into every envelope
+   * @param sequence  counter shared by the shard's books (NULL = this
+   *                  queue's own); must outlive the queue
+   */
+  void set_source(uint32_t shard, uint64_t *sequence) {
+    shard_ = shard;
+    sequence_ = sequence;
+  }
+
+  /// Ingress time of the request about to be applied
+  void set_ingress_time(uint64_t ns) { ingress_ns_ = ns; }
+
+  /// The current operation is complete; the next event starts a new stamp
+  void end_operation() {
+    stamped_ = false;
+    ingress_ns_ = 0;
+  }
+
+  void accept(const OrderPtr &order) { push(Callback(ACCEPT, order)); }
+
+  void reject(const OrderPtr &order, const char *reason) {
+    push(Callback(REJECT, order, reason));
+  }
+
+  /// @param order  the inbound (taking) order
+  /// @param matched  the resting order it traded with
+  void fill(const OrderPtr &order, const OrderPtr &matched, Quantity qty,
+            Price price) {
+    Callback cb(FILL, order);
+    cb.matched = matched;
+    cb.qty = qty;
+    cb.price = price;
+    push(cb);
+  }
+
+  void cancel(const OrderPtr &order) { push(Callback(CANCEL, order)); }
+
+  /**
+   * Queue a cancel report for every order in `orders`.
+   *
+   * Used by bulk purges: one queue entry points at the whole array instead
+   * of one entry per order. The orders are taken over without copying
+   * when nothing else is batched, and `orders` is left empty either way.
+   */
+  void cancel_batch(std::vector<OrderPtr> &orders) {
+    if (orders.empty()) {
+      return;
+    }
+    Callback cb(CANCEL_BATCH, OrderPtr());
+    cb.qty = batch_.size();
+    cb.delta = int64_t(orders.size());
+    if (batch_.empty()) {
+      batch_.swap(orders);
+    } else {
+      batch_.insert(batch_.end(), orders.begin(), orders.end());
+    }
+    orders.clear();
+    push(cb, uint64_t(cb.delta));
+  }
+
+  void cancel_reject(const OrderPtr &order, const char *reason) {
+    push(Callback(CANCEL_REJECT, order, reason));
+  }
+
+  void replace(const OrderPtr &order, int64_t size_delta, Price new_price) {
+    Callback cb(REPLACE, order);
+    cb.delta = size_delta;
+    cb.price = new_price;
+    push(cb);
+  }
+
+  void replace_reject(const OrderPtr &order, const char *reason) {
+    push(Callback(REPLACE_REJECT, order, reason));
+  }
+
+  /// Deliver every queued event in order, then clear the queue
+  void perform(TypedOrderListener *listener) {
+    if (listener != NULL) {
+      EventEnvelope *envelope = NULL;
+      if (envelopes_ != NULL && listener == envelopes_) {
+        envelope = &envelopes_->envelope_;
+        *envelope = EventEnvelope(); // events queued before stamping began
+      }
+      size_t next_stamp = 0;
+      for (size_t i = 0; i < callbacks_.size(); ++i) {
+        if (envelope != NULL && next_stamp < stamps_.size() &&
+            stamps_[next_stamp].first_callback == i) {
+          *envelope = stamps_[next_stamp++].envelope;
+        }
+        perform_callback(*listener, callbacks_[i], envelope);
+      }
+    }
+    callbacks_.clear();
+    batch_.clear();
+    stamps_.clear();
+    stamped_ = false;
+  }
+
+  bool empty() const { return callbacks_.empty(); }
+
+private:
+  enum Type {
+    ACCEPT,
+    REJECT,
+    FILL,
+    CANCEL,
+    CANCEL_REJECT,
+    REPLACE,
+    REPLACE_REJECT,
+    CANCEL_BATCH // qty = first index in batch_, delta = count
+  };
+
+  struct Callback {
+    Callback(Type t, const OrderPtr &o, const char *r = NULL)
+        : type(t), order(o), matched(), qty(0), price(0), delta(0), reason(r) {}
+    Type type;
+    OrderPtr order;
+    OrderPtr matched;
+    Quantity qty;
+    Price price;
+    int64_t delta;
+    const char *reason;
+  };
+
+  /// One operation's envelope, shared by its events from first_callback on
+  struct Stamp {
+    EventEnvelope envelope; // sequence = the first event's
+    size_t first_callback;
+  };
+
+  /// @param events  events `cb` delivers (sequence numbers it uses)
+  void push(const Callback &cb, uint64_t events = 1) {
+    if (envelopes_ != NULL) {
+      uint64_t &sequence = sequence_ != NULL ? *sequence_ : own_sequence_;
+      if (!stamped_) {
+        Stamp stamp;
+        stamp.envelope.ingress_ns = ingress_ns_;
+        const uint64_t now = TscClock::now();
+        stamp.envelope.match_ns = now > ingress_ns_ ? now : ingress_ns_;
+        stamp.envelope.sequence = sequence;
+        stamp.envelope.shard = shard_;
+        stamp.first_callback = callbacks_.size();
+        stamps_.push_back(stamp);
+        stamped_ = true;
+      }
+      sequence += events;
+    }
+    callbacks_.push_back(cb);
+  }
+
+  /// @param envelope  the listener's envelope, advanced per event (or NULL)
+  void perform_callback(TypedOrderListener &listener, const Callback &cb,
+                        EventEnvelope *envelope) {
+    switch (cb.type) {
+    case ACCEPT:
+      listener.on_accept(cb.order);
+      break;
+    case REJECT:
+      listener.on_reject(cb.order, cb.reason);
+      break;
+    case FILL:
+      listener.on_fill(cb.order, cb.matched, cb.qty, cb.price);
+      break;
+    case CANCEL:
+      listener.on_cancel(cb.order);
+      break;
+    case CANCEL_REJECT:
+      listener.on_cancel_reject(cb.order, cb.reason);
+      break;
+    case REPLACE:
+      listener.on_replace(cb.order, cb.delta, cb.price);
+      break;
+    case REPLACE_REJECT:
+      listener.on_replace_reject(cb.order, cb.reason);
+      break;
+    case CANCEL_BATCH:
+      for (size_t i = cb.qty; i < cb.qty + size_t(cb.delta); ++i) {
+        listener.on_cancel(batch_[i]);
+        if (envelope != NULL) {
+          ++envelope->sequence;
+        }
+      }
+      return;
+    }
+    if (envelope != NULL) {
+      ++envelope->sequence;
+    }
+  }
+
+  std::vector<Callback> callbacks_;
+  std::vector<OrderPtr> batch_; // orders of CANCEL_BATCH entries
+  std::vector<Stamp> stamps_;   // one per stamped operation, in order
+  TypedEnvelopeListener *envelopes_;
+  bool stamped_; // the current operation has a stamp
+  uint64_t ingress_ns_;
+  uint32_t shard_;
+  uint64_t own_sequence_;
+  uint64_t *sequence_; // shared shard counter, or NULL for own_sequence_
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include <LevelBook.h>
+#include <TradingSession.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: BookManager
+ * ============================================================================
+ * Owns every symbol's LevelBook, split across shards.
+ *
+ * A shard is the set of books one matching thread owns. Symbols are spread
+ * over shards by a hash of the symbol, and each book also belongs to a
+ * schedule group (see SessionSchedule) that decides its trading hours.
+ *
+ * Session transitions are applied in bulk: one transition for a group
+ * becomes one control batch per shard, and each shard walks its own books
+ * in a tight loop. At 09:30:00 that is a handful of batches, not one
+ * message per symbol.
+ *
+ * Option chains: an underlying can have thousands of series (strikes x
+ * expiries), each its own book, and most actions hit all of them at once
+ * (the underlying halts, a maker pulls every quote). add_chain() puts all
+ * series of one underlying on the same shard, in one contiguous array, so
+ * chain operations are a linear walk over adjacent books with no per-book
+ * symbol lookup. Mass quoting a chain goes through
+ * QuoteManager::add_books() / mass_quote_series() with the same array.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr> class BookManager {
+public:
+  typedef LevelBook<OrderPtr> Book;
+  typedef liquibook::book::OrderListener<OrderPtr> TypedOrderListener;
+  typedef EnvelopeListener<OrderPtr> TypedEnvelopeListener;
+
+  /**
+   * A control batch for one shard: move every book of `group` to `state`.
+   */
+  struct ShardTransition {
+    uint16_t group;
+    SessionState state;
+  };
+
+  /**
+   * All series of one underlying. `series` is allocated once and never
+   * resized, so the books stay contiguous and never move.
+   */
+  struct Chain {
+    std::string underlying;
+    uint16_t group;           // schedule group of every series
+    std::vector<Book> series; // one book per option series
+  };
+
+  /// @param shard_count  number of shards (matching threads)
+  explicit BookManager(size_t shard_count = 1)
+      : shards_(shard_count ? shard_count : 1), listener_(NULL),
+        envelope_listener_(NULL) {}
+
+  /// Listener attached to every book added from now on
+  void set_order_listener(TypedOrderListener *listener) {
+    listener_ = listener;
+    envelope_listener_ = NULL;
+  }
+
+  /**
+   * Same, and every book stamps its events with an EventEnvelope carrying
+   * its shard ID and a sequence number that is gap-free per shard.
+   */
+  void set_order_listener(TypedEnvelopeListener *listener) {
+    listener_ = listener;
+    envelope_listener_ = listener;
+  }
+
+  /**
+   * Create a book.
+   *
+   * @param symbol  instrument symbol
+   * @param group   schedule group the symbol trades under
+   * @param policy  matching policy for the symbol
+   * @param state   initial trading state
+   */
+  Book &add_book(const std::string &symbol, uint16_t group = 0,
+                 MatchPolicy policy = MATCH_FIFO,
+                 SessionState state = STATE_PRE_OPEN) {
+    size_t shard = std::hash<std::string>()(symbol) % shards_.size();
+    Shard &s = shards_[shard];
+    s.books.emplace_back(symbol, policy, state);
+    s.groups.push_back(group);
+    Book &book = s.books.back();
+    attach(book, shard);
+    index_[symbol] = Location(shard, s.books.size() - 1);
+    return book;
+  }
+
+  /**
+   * Create the books of an option chain, side by side on one shard.
+   *
+   * @param underlying  underlying symbol, used to pick the shard
+   * @param series      symbol of every series
+   * @param group       schedule group the chain trades under
+   * @param policy      matching policy for every series
+   * @param state       initial trading state
+   * @return the chain (its series are in the order given)
+   */
+  Chain &add_chain(const std::string &underlying,
+                   const std::vector<std::string> &series, uint16_t group = 0,
+                   MatchPolicy policy = MATCH_FIFO,
+                   SessionState state = STATE_PRE_OPEN) {
+    size_t shard = std::hash<std::string>()(underlying) % shards_.size();
+    Shard &s = shards_[shard];
+    s.chains.push_back(Chain());
+    Chain &chain = s.chains.back();
+    chain.underlying = underlying;
+    chain.group = group;
+    chain.series.reserve(series.size());
+    for (size_t i = 0; i < series.size(); ++i) {
+      chain.series.push_back(Book(series[i], policy, state));
+      attach(chain.series.back(), shard);
+      index_[series[i]] = Location(shard, i, s.chains.size() - 1);
+    }
+    chain_index_[underlying] = &chain;
+    return chain;
+  }
+
+  /// @return an underlying's chain, or NULL
+  Chain *find_chain(const std::string &underlying) {
+    typename ChainIndex::iterator it = chain_index_.find(underlying);
+    return it == chain_index_.end() ? NULL : it->second;
+  }
+
+  /**
+   * Move every series of a chain to a new state, e.g. STATE_HALTED when
+   * the underlying halts and STATE_CONTINUOUS when it resumes.
+   *
+   * @return number of series that changed state
+   */
+  size_t set_chain_state(Chain &chain, SessionState state) {
+    size_t changed = 0;
+    for (size_t i = 0; i < chain.series.size(); ++i) {
+      if (chain.series[i].set_state(state)) {
+        chain.series[i].perform_callbacks();
+        ++changed;
+      }
+    }
+    return changed;
+  }
+
+  /**
+   * Cancel the resting orders `pred(order)` selects in every series of a
+   * chain (e.g. one session's orders), one batch per book.
+   *
+   * @return number of orders canceled
+   */
+  template <class Pred> size_t mass_cancel(Chain &chain, Pred pred) {
+    size_t canceled = 0;
+    for (size_t i = 0; i < chain.series.size(); ++i) {
+      Book &book = chain.series[i];
+      if (book.resting_count() != 0) {
+        canceled += book.cancel_where(pred);
+        book.perform_callbacks();
+      }
+    }
+    return canceled;
+  }
+
+  /// Cancel every resting order in a chain
+  size_t mass_cancel(Chain &chain) { return mass_cancel(chain, AllOrders()); }
+
+  /// @return the book for a symbol, or NULL
+  Book *find(const std::string &symbol) {
+    typename Index::iterator it = index_.find(symbol);
+    if (it == index_.end()) {
+      return NULL;
+    }
+    Shard &s = shards_[it->second.shard];
+    return it->second.chain == NO_CHAIN
+               ? &s.books[it->second.index]
+               : &s.chains[it->second.chain].series[it->second.index];
+  }
+
+  /// @return shard that owns a symbol, or shard_count() if unknown
+  size_t shard_of(const std::string &symbol) const {
+    typename Index::const_iterator it = index_.find(symbol);
+    return it == index_.end() ? shards_.size() : it->second.shard;
+  }
+
+  size_t shard_count() const { return shards_.size(); }
+
+  /**
+   * Move a whole schedule group to a new state: one batch per shard.
+   * This is what SessionSchedule::advance() calls.
+   *
+   * @return number of books that changed state
+   */
+  size_t transition(uint16_t group, SessionState state) {
+    ShardTransition batch;
+    batch.group = group;
+    batch.state = state;
+    size_t changed = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      changed += apply(shards_[i], batch);
+    }
+    return changed;
+  }
+
+  /// Halt or resume one symbol (e.g. volatility halt)
+  bool set_state(const std::string &symbol, SessionState state) {
+    Book *book = find(symbol);
+    if (book == NULL || !book->set_state(state)) {
+      return false;
+    }
+    book->perform_callbacks();
+    return true;
+  }
+
+private:
+  static const size_t NO_CHAIN = ~size_t(0);
+
+  struct Shard {
+    std::deque<Book> books;       // deque: books never move once created
+    std::vector<uint16_t> groups; // parallel to books
+    std::deque<Chain> chains;
+    uint64_t sequence = 0; // next event sequence number
+  };
+
+  struct Location {
+    Location(size_t s = 0, size_t i = 0, size_t c = NO_CHAIN)
+        : shard(s), index(i), chain(c) {}
+    size_t shard;
+    size_t index; // in the shard's books, or in the chain's series
+    size_t chain; // NO_CHAIN for a stand-alone book
+  };
+
+  struct AllOrders {
+    bool operator()(const OrderPtr &) const { return true; }
+  };
+
+  typedef std::unordered_map<std::string, Location> Index;
+  typedef std::unordered_map<std::string, Chain *> ChainIndex;
+
+  /// Give a new book the current listener and its shard's event source
+  void attach(Book &book, size_t shard) {
+    if (envelope_listener_ != NULL) {
+      book.set_order_listener(envelope_listener_);
+    } else {
+      book.set_order_listener(listener_);
+    }
+    book.set_event_source(uint32_t(shard), &shards_[shard].sequence);
+  }
+
+  /// Runs on the shard's own thread in a threaded engine
+  size_t apply(Shard &shard, const ShardTransition &batch) {
+    size_t changed = 0;
+    for (size_t i = 0; i < shard.books.size(); ++i) {
+      if (shard.groups[i] == batch.group &&
+          shard.books[i].set_state(batch.state)) {
+        shard.books[i].perform_callbacks(); // auction uncross fills
+        ++changed;
+      }
+    }
+    for (size_t c = 0; c < shard.chains.size(); ++c) {
+      if (shard.chains[c].group == batch.group) {
+        changed += set_chain_state(shard.chains[c], batch.state);
+      }
+    }
+    return changed;
+  }
+
+  std::vector<Shard> shards_;
+  Index index_;
+  ChainIndex chain_index_;
+  TypedOrderListener *listener_;
+  TypedEnvelopeListener *envelope_listener_; // listener_, if it is one
+};
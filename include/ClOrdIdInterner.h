@@ -0,0 +1,234 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: ClOrdIdInterner
+ * ============================================================================
+ * Maps external (session, ClOrdID) strings to dense 64-bit internal IDs.
+ *
+ * Clients (FIX, binary protocols) identify their orders with string IDs such
+ * as "BUY_001". Comparing and hashing strings on every book operation is
+ * slow, so the gateway interns each string once and the engine only ever
+ * sees the integer. The original string is kept so reports sent back to the
+ * client still carry the client's own ID.
+ *
+ * Internal IDs are dense: released IDs are recycled, so they can be used
+ * directly as indexes into per-order arrays.
+ *
+ * The lookup table uses open addressing with linear probing. Deletion shifts
+ * the following entries back instead of leaving tombstones, so lookups never
+ * slow down after many cancels.
+ */
+class ClOrdIdInterner {
+public:
+  /// Returned by find() when the key is not interned
+  static const uint64_t INVALID_ID = ~uint64_t(0);
+
+  /**
+   * @param initial_capacity  expected number of live IDs (table grows as
+   *                          needed, this only avoids early rehashing)
+   */
+  explicit ClOrdIdInterner(size_t initial_capacity = 1024) {
+    size_t capacity = 16;
+    while (capacity < initial_capacity * 2) {
+      capacity <<= 1;
+    }
+    slots_.assign(capacity, Slot());
+    mask_ = capacity - 1;
+    entries_.reserve(initial_capacity);
+  }
+
+  /**
+   * Hash a short key eight bytes at a time.
+   *
+   * ClOrdIDs are almost always under 32 bytes, so the key is consumed in
+   * 8-byte words spread over four independent lanes. The lanes have no data
+   * dependency on each other, which lets the CPU (and the auto-vectorizer)
+   * process them in parallel instead of one byte per step.
+   *
+   * @param data  key bytes
+   * @param len   key length
+   * @param seed  mixed into every lane (we pass the session ID)
+   */
+  static uint64_t hash(const char *data, size_t len, uint64_t seed) {
+    const uint64_t k0 = 0x9E3779B97F4A7C15ULL;
+    const uint64_t k1 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t lanes[4] = {seed ^ k0, seed ^ k1, seed + k0, seed - k1};
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+      for (int lane = 0; lane < 4; ++lane) {
+        lanes[lane] = mix(lanes[lane] ^ load_word(data + i + lane * 8));
+      }
+    }
+    // Tail: up to 31 bytes, zero padded into whole words
+    for (int lane = 0; i < len; ++lane, i += 8) {
+      uint64_t word = 0;
+      std::memcpy(&word, data + i, len - i < 8 ? len - i : 8);
+      lanes[lane] = mix(lanes[lane] ^ word);
+    }
+
+    uint64_t h = lanes[0] ^ (lanes[1] * k0) ^ (lanes[2] * k1) ^ lanes[3];
+    return mix(h ^ len);
+  }
+
+  /**
+   * Return the internal ID for a client order ID, creating it if needed.
+   *
+   * @param session  gateway session the order arrived on
+   * @param clordid  client order ID as sent by the client
+   */
+  uint64_t intern(uint32_t session, const std::string &clordid) {
+    uint64_t h = hash(clordid.data(), clordid.size(), session);
+    size_t pos = probe(session, clordid, h);
+    if (slots_[pos].id != INVALID_ID) {
+      return slots_[pos].id;
+    }
+
+    uint64_t id = allocate_id(session, clordid);
+    slots_[pos].id = id;
+    slots_[pos].hash = h;
+    ++size_;
+    if (size_ * 2 > slots_.size()) {
+      grow();
+    }
+    return id;
+  }
+
+  /**
+   * Look up an existing client order ID without creating it.
+   *
+   * @return the internal ID, or INVALID_ID if never interned
+   */
+  uint64_t find(uint32_t session, const std::string &clordid) const {
+    uint64_t h = hash(clordid.data(), clordid.size(), session);
+    return slots_[probe(session, clordid, h)].id;
+  }
+
+  /**
+   * Forget an internal ID once the order is done (filled or canceled).
+   *
+   * The entries after it in the same probe run are shifted back into the
+   * hole, so no tombstone is left behind.
+   *
+   * @return false if the ID was not live
+   */
+  bool release(uint64_t id) {
+    if (id >= entries_.size() || !entries_[id].live) {
+      return false;
+    }
+    Entry &entry = entries_[id];
+    size_t hole = probe(entry.session, entry.clordid,
+                        hash(entry.clordid.data(), entry.clordid.size(),
+                             entry.session));
+
+    // Backward-shift deletion
+    size_t next = (hole + 1) & mask_;
+    while (slots_[next].id != INVALID_ID) {
+      size_t home = slots_[next].hash & mask_;
+      // Move the entry if its home bucket is not between hole and next
+      if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+        slots_[hole] = slots_[next];
+        hole = next;
+      }
+      next = (next + 1) & mask_;
+    }
+    slots_[hole] = Slot();
+
+    entry.live = false;
+    entry.clordid.clear();
+    free_ids_.push_back(id);
+    --size_;
+    return true;
+  }
+
+  /// @return the client's original order ID for an internal ID
+  const std::string &clordid(uint64_t id) const { return entries_[id].clordid; }
+  /// @return the session an internal ID belongs to
+  uint32_t session(uint64_t id) const { return entries_[id].session; }
+  /// @return number of live IDs
+  size_t size() const { return size_; }
+
+private:
+  struct Slot {
+    uint64_t id = INVALID_ID;
+    uint64_t hash = 0;
+  };
+
+  struct Entry {
+    uint32_t session = 0;
+    bool live = false;
+    std::string clordid;
+  };
+
+  static uint64_t load_word(const char *p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+  }
+
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  /// @return slot holding the key, or the empty slot where it would go
+  size_t probe(uint32_t session, const std::string &clordid,
+               uint64_t h) const {
+    size_t pos = h & mask_;
+    while (slots_[pos].id != INVALID_ID) {
+      if (slots_[pos].hash == h) {
+        const Entry &entry = entries_[slots_[pos].id];
+        if (entry.session == session && entry.clordid == clordid) {
+          break;
+        }
+      }
+      pos = (pos + 1) & mask_;
+    }
+    return pos;
+  }
+
+  uint64_t allocate_id(uint32_t session, const std::string &clordid) {
+    uint64_t id;
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    } else {
+      id = entries_.size();
+      entries_.push_back(Entry());
+    }
+    entries_[id].session = session;
+    entries_[id].clordid = clordid;
+    entries_[id].live = true;
+    return id;
+  }
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.assign(old.size() * 2, Slot());
+    mask_ = slots_.size() - 1;
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i].id == INVALID_ID) {
+        continue;
+      }
+      size_t pos = old[i].hash & mask_;
+      while (slots_[pos].id != INVALID_ID) {
+        pos = (pos + 1) & mask_;
+      }
+      slots_[pos] = old[i];
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<Entry> entries_; // indexed by internal ID
+  std::vector<uint64_t> free_ids_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
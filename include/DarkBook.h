@@ -0,0 +1,308 @@
+#pragma once
+#include <BookCallbacks.h>
+#include <LevelBook.h>
+#include <book/types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Which midpoint order trades first when the dark book crosses.
+ */
+enum DarkPriority {
+  DARK_TIME_PRIORITY, // oldest first
+  DARK_SIZE_PRIORITY  // largest first, then oldest
+};
+
+/**
+ * ============================================================================
+ * CLASS: DarkBook
+ * ============================================================================
+ * A midpoint-only "dark" book that sits next to a lit LevelBook.
+ *
+ * Dark orders have no price of their own: they are pegged to the middle of
+ * the lit book's best bid and offer, and trade there. Nobody sees them in
+ * market data. Buyer and seller both get a better price than crossing the
+ * lit spread.
+ *
+ * Because every dark order is pegged to the same midpoint, any dark buy can
+ * trade with any dark sell. So the book never holds both buyers and sellers
+ * while the lit market is two-sided: they would already have traded. That
+ * makes the crossing check one comparison, "are both sides non-empty?",
+ * done when a dark order arrives and on each lit BBO change. Resting orders
+ * are never repriced; the fill price is just the current midpoint.
+ *
+ * Each side is a flat array kept in priority order (see DarkPriority).
+ * price() on dark orders is ignored.
+ *
+ * Events are queued and stamped like a LevelBook's: give
+ * set_order_listener() an EnvelopeListener, and set_event_source() the
+ * lit book's shard counter to number dark and lit events in one sequence.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr>
+class DarkBook : public BboChangeListener<LevelBook<OrderPtr> > {
+public:
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef liquibook::book::OrderConditions OrderConditions;
+  typedef liquibook::book::OrderListener<OrderPtr> TypedOrderListener;
+  typedef EnvelopeListener<OrderPtr> TypedEnvelopeListener;
+  typedef LevelBook<OrderPtr> LitBook;
+  typedef typename LitBook::TypedBboListener TypedBboListener;
+
+  explicit DarkBook(const std::string &symbol = "unknown",
+                    DarkPriority priority = DARK_TIME_PRIORITY)
+      : symbol_(symbol), priority_(priority), listener_(NULL), next_(NULL),
+        midpoint_(0) {}
+
+  const std::string &symbol() const { return symbol_; }
+
+  void set_order_listener(TypedOrderListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(NULL);
+  }
+
+  /// Same, and stamp every event with an EventEnvelope for `listener`
+  void set_order_listener(TypedEnvelopeListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(listener);
+  }
+
+  /**
+   * @param shard     shard ID for event envelopes
+   * @param sequence  event counter shared by the shard's books
+   */
+  void set_event_source(uint32_t shard, uint64_t *sequence) {
+    callbacks_.set_source(shard, sequence);
+  }
+
+  /// Ingress time of the next add/cancel, for its envelopes
+  void set_ingress_time(uint64_t ns) { callbacks_.set_ingress_time(ns); }
+
+  /**
+   * Follow a lit book's BBO. Sets this book as the lit book's BBO
+   * listener; every change is passed on to the listener that was there
+   * before (e.g. a SpreadBook using the lit book as a leg).
+   */
+  void attach(LitBook &lit) {
+    next_ = lit.bbo_listener();
+    lit.set_bbo_listener(this);
+    follow(lit.bbo());
+  }
+
+  /**
+   * Add a midpoint order. It trades at once if the other dark side has
+   * orders and the lit market is two-sided; otherwise it rests.
+   *
+   * @param conditions  IOC cancels whatever doesn't trade at once;
+   *                    all-or-none is not supported
+   * @return true if the order traded
+   */
+  bool add(const OrderPtr &order, OrderConditions conditions = 0) {
+    const bool traded = place(order, conditions);
+    callbacks_.end_operation();
+    return traded;
+  }
+
+  /// Cancel a resting dark order
+  void cancel(const OrderPtr &order) {
+    Side &side = order->is_buy() ? bids_ : asks_;
+    size_t slot = side.find(order);
+    if (slot == side.orders.size()) {
+      callbacks_.cancel_reject(order, "not found");
+    } else {
+      side.remove(slot);
+      callbacks_.cancel(order);
+    }
+    callbacks_.end_operation();
+  }
+
+  /// Deliver queued events to the listener
+  void perform_callbacks() { callbacks_.perform(listener_); }
+
+  /// Lit BBO moved: update the midpoint and check for a cross, then pass
+  /// it on
+  void on_bbo_change(const LitBook *book, const Bbo &bbo) override {
+    follow(bbo);
+    if (next_ != NULL) {
+      next_->on_bbo_change(book, bbo);
+    }
+  }
+
+  void on_signals_change(const LitBook *book,
+                         const BookSignals &signals) override {
+    if (next_ != NULL) {
+      next_->on_signals_change(book, signals);
+    }
+  }
+
+  /// @return current midpoint (rounded down to a whole tick), 0 if none
+  Price midpoint() const { return midpoint_; }
+  /// @return resting dark quantity on one side
+  Quantity resting_qty(bool is_buy) const {
+    return is_buy ? bids_.total_qty : asks_.total_qty;
+  }
+
+private:
+  /// New midpoint from the lit BBO; trade if the dark book now crosses
+  void follow(const Bbo &bbo) {
+    midpoint_ = bbo.two_sided() ? (bbo.bid_price + bbo.ask_price) / 2 : 0;
+    cross();
+    callbacks_.end_operation();
+  }
+
+  /// add() without closing the event stamp
+  bool place(const OrderPtr &order, OrderConditions conditions) {
+    const bool ioc = (conditions & liquibook::book::oc_immediate_or_cancel) ||
+                     order->immediate_or_cancel();
+    if (order->order_qty() == 0) {
+      callbacks_.reject(order, "size must be positive");
+      return false;
+    }
+    if ((conditions & liquibook::book::oc_all_or_none) ||
+        order->all_or_none()) {
+      callbacks_.reject(order, "all-or-none is not supported in the dark");
+      return false;
+    }
+    callbacks_.accept(order);
+
+    Side &side = order->is_buy() ? bids_ : asks_;
+    size_t slot = side.insert(order, order->order_qty(), priority_);
+    const size_t compactions = side.compactions;
+    bool traded = cross();
+    if (ioc && side.live != 0) {
+      if (side.compactions != compactions) {
+        slot = side.find(order); // trading moved it
+      }
+      if (slot < side.orders.size() && side.orders[slot] == order &&
+          side.open_qty[slot] != 0) {
+        side.remove(slot);
+        callbacks_.cancel(order);
+      }
+    }
+    return traded;
+  }
+
+  /**
+   * One side: flat arrays in priority order, consumed from `head`.
+   * Filled and canceled orders leave dead slots behind; once they
+   * outnumber the live ones the arrays are compacted, so a side never
+   * holds more than twice its live orders and find() stays short.
+   */
+  struct Side {
+    Side() : head(0), total_qty(0), live(0), compactions(0) {}
+
+    /// @return the order's slot
+    size_t insert(const OrderPtr &order, Quantity qty, DarkPriority priority) {
+      size_t pos = orders.size();
+      if (priority == DARK_SIZE_PRIORITY) {
+        // After every order at least as large (ties stay in time order)
+        pos = head;
+        while (pos < orders.size() && rank[pos] >= qty) {
+          ++pos;
+        }
+      }
+      orders.insert(orders.begin() + pos, order);
+      open_qty.insert(open_qty.begin() + pos, qty);
+      rank.insert(rank.begin() + pos, qty);
+      total_qty += qty;
+      ++live;
+      return pos;
+    }
+
+    size_t find(const OrderPtr &order) const {
+      for (size_t slot = head; slot < orders.size(); ++slot) {
+        if (orders[slot] == order && open_qty[slot] != 0) {
+          return slot;
+        }
+      }
+      return orders.size();
+    }
+
+    void reduce(size_t slot, Quantity qty) {
+      open_qty[slot] -= qty;
+      total_qty -= qty;
+      if (open_qty[slot] == 0) {
+        --live;
+        if (live == 0) {
+          orders.clear();
+          open_qty.clear();
+          rank.clear();
+          head = 0;
+        } else if (orders.size() - live > live) {
+          compact();
+        } else {
+          while (open_qty[head] == 0) {
+            ++head;
+          }
+        }
+      }
+    }
+
+    void remove(size_t slot) { reduce(slot, open_qty[slot]); }
+
+    /// Drop the dead slots, keeping priority order (moves every slot)
+    void compact() {
+      size_t out = 0;
+      for (size_t slot = head; slot < orders.size(); ++slot) {
+        if (open_qty[slot] != 0) {
+          orders[out] = orders[slot];
+          open_qty[out] = open_qty[slot];
+          rank[out] = rank[slot];
+          ++out;
+        }
+      }
+      orders.erase(orders.begin() + out, orders.end());
+      open_qty.erase(open_qty.begin() + out, open_qty.end());
+      rank.erase(rank.begin() + out, rank.end());
+      head = 0;
+      ++compactions;
+    }
+
+    std::vector<OrderPtr> orders;
+    std::vector<Quantity> open_qty; // 0 = filled or canceled
+    std::vector<Quantity> rank;     // size at arrival (size priority key)
+    size_t head;
+    Quantity total_qty;
+    size_t live;
+    size_t compactions; // slots moved: positions from before are stale
+  };
+
+  /**
+   * Trade dark buyers against dark sellers at the midpoint.
+   * @return true if anything traded
+   */
+  bool cross() {
+    // The single crossing check
+    if (midpoint_ == 0 || bids_.live == 0 || asks_.live == 0) {
+      return false;
+    }
+    while (bids_.live != 0 && asks_.live != 0) {
+      size_t b = bids_.head;
+      size_t a = asks_.head;
+      Quantity qty = bids_.open_qty[b] < asks_.open_qty[a] ? bids_.open_qty[b]
+                                                           : asks_.open_qty[a];
+      callbacks_.fill(bids_.orders[b], asks_.orders[a], qty, midpoint_);
+      bids_.reduce(b, qty);
+      asks_.reduce(a, qty);
+    }
+    return true;
+  }
+
+  std::string symbol_;
+  DarkPriority priority_;
+  TypedOrderListener *listener_;
+  TypedBboListener *next_; // lit book's previous BBO listener
+  CallbackQueue<OrderPtr> callbacks_;
+  Side bids_;
+  Side asks_;
+  Price midpoint_;
+};
+
+/// Lets OrderGateway pass ingress times to a DarkBook
+template <class OrderPtr>
+void set_ingress_time(DarkBook<OrderPtr> &book, uint64_t ns) {
+  book.set_ingress_time(ns);
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <book/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Result of a cost-to-fill query: what an order for `qty` would get if it
+ * swept the book right now.
+ */
+struct FillEstimate {
+  liquibook::book::Quantity filled = 0; // < requested if the side runs dry
+  liquibook::book::Cost cost = 0;       // sum of price * quantity
+  liquibook::book::Price worst_price = 0; // last level reached
+  size_t levels = 0;                      // price levels consumed
+
+  /// @return volume-weighted average price (0 if nothing fills)
+  double average_price() const {
+    return filled ? double(cost) / double(filled) : 0.0;
+  }
+};
+
+/**
+ * ============================================================================
+ * CLASS: DepthSnapshot
+ * ============================================================================
+ * A read-only copy of a book's displayed depth, built for queries.
+ *
+ * Each side is stored best price first as flat arrays, with running
+ * totals ("prefix sums") of quantity and cost:
+ *
+ *   level:     0      1      2
+ *   price:   100    101    103
+ *   qty:      50     30     70
+ *   cum_qty:  50     80    150
+ *   cum_cost: 5000  8030  15240
+ *
+ * "What would buying 60 cost?" is then a binary search for the first
+ * level whose cum_qty reaches 60 (level 1), plus one multiply for the part
+ * of that level used: 5000 + 10 * 101. That is O(log levels) and touches
+ * a few cache lines, without walking orders or changing the book.
+ *
+ * Every query names a side of the book (BID or ASK), never the side of
+ * the order: buying 60 is cost_to_fill(DepthSnapshot::ASK, 60).
+ *
+ * Only displayed quantity is included: hidden orders are not market data.
+ */
+class DepthSnapshot {
+public:
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef liquibook::book::Cost Cost;
+
+  /// A side of the book
+  enum BookSide { BID, ASK };
+
+  /**
+   * Rebuild from a book's current levels (capacity is reused).
+   *
+   * @param book        a LevelBook (anything with bids()/asks() maps of
+   *                    PriceLevel)
+   * @param max_levels  levels kept per side (0 = all)
+   */
+  template <class Book> void build(const Book &book, size_t max_levels = 0) {
+    bids_.build(book.bids(), max_levels);
+    asks_.build(book.asks(), max_levels);
+  }
+
+  /**
+   * Cost to sweep `qty` from one side of the book right now.
+   *
+   * @param side  side the order trades against: ASK to buy, BID to sell
+   * @param qty   hypothetical order size
+   */
+  FillEstimate cost_to_fill(BookSide side, Quantity qty) const {
+    return ladder(side).cost_to_fill(qty);
+  }
+
+  /// @return displayed quantity on one side (within the kept levels)
+  Quantity total_qty(BookSide side) const {
+    const Ladder &l = ladder(side);
+    return l.cum_qty.empty() ? 0 : l.cum_qty.back();
+  }
+
+  /// @return number of levels kept on one side
+  size_t level_count(BookSide side) const { return ladder(side).price.size(); }
+
+private:
+  /// One side's levels, best price first
+  struct Ladder {
+    template <class Levels> void build(const Levels &levels, size_t max) {
+      price.clear();
+      cum_qty.clear();
+      cum_cost.clear();
+      Quantity qty_total = 0;
+      Cost cost_total = 0;
+      for (typename Levels::const_iterator it = levels.begin();
+           it != levels.end() && (max == 0 || price.size() < max); ++it) {
+        Quantity qty = it->second.displayed_qty();
+        if (qty == 0) {
+          continue; // hidden-only level
+        }
+        qty_total += qty;
+        cost_total += Cost(it->first) * qty;
+        price.push_back(it->first);
+        cum_qty.push_back(qty_total);
+        cum_cost.push_back(cost_total);
+      }
+    }
+
+    FillEstimate cost_to_fill(Quantity qty) const {
+      FillEstimate estimate;
+      if (qty == 0 || price.empty()) {
+        return estimate;
+      }
+      // First level whose running total reaches qty
+      size_t k = std::lower_bound(cum_qty.begin(), cum_qty.end(), qty) -
+                 cum_qty.begin();
+      if (k == cum_qty.size()) {
+        // Not enough: sweep everything
+        estimate.filled = cum_qty.back();
+        estimate.cost = cum_cost.back();
+        estimate.worst_price = price.back();
+        estimate.levels = price.size();
+        return estimate;
+      }
+      Quantity before_qty = k ? cum_qty[k - 1] : 0;
+      Cost before_cost = k ? cum_cost[k - 1] : 0;
+      estimate.filled = qty;
+      estimate.cost = before_cost + Cost(price[k]) * (qty - before_qty);
+      estimate.worst_price = price[k];
+      estimate.levels = k + 1;
+      return estimate;
+    }
+
+    std::vector<Price> price; // best first
+    std::vector<Quantity> cum_qty;
+    std::vector<Cost> cum_cost;
+  };
+
+  const Ladder &ladder(BookSide side) const {
+    return side == BID ? bids_ : asks_;
+  }
+
+  Ladder bids_;
+  Ladder asks_;
+};
+
+/**
+ * ============================================================================
+ * CLASS: SnapshotPublisher
+ * ============================================================================
+ * Hands DepthSnapshots from the matching thread to any number of readers.
+ *
+ * The matching thread calls publish() after a batch of book changes.
+ * Readers call current() and query the snapshot they got for as long as
+ * they like: a published snapshot is never modified. Snapshots no reader
+ * holds any more are recycled, so publishing doesn't allocate once warm.
+ */
+class SnapshotPublisher {
+public:
+  typedef std::shared_ptr<const DepthSnapshot> Ptr;
+
+  /// Matching thread: build a snapshot of `book` and make it current
+  template <class Book> void publish(const Book &book, size_t max_levels = 0) {
+    std::shared_ptr<DepthSnapshot> next = spare();
+    next->build(book, max_levels);
+    Ptr previous = std::atomic_exchange(&current_, Ptr(next));
+    if (previous) {
+      retired_.push_back(std::const_pointer_cast<DepthSnapshot>(previous));
+    }
+  }
+
+  /// Any thread: the latest snapshot (empty before the first publish)
+  Ptr current() const { return std::atomic_load(&current_); }
+
+private:
+  /// A retired snapshot nobody reads any more, or a new one
+  std::shared_ptr<DepthSnapshot> spare() {
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].use_count() == 1) {
+        // The last reader's accesses happen before we overwrite it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::shared_ptr<DepthSnapshot> reuse = retired_[i];
+        retired_[i] = retired_.back();
+        retired_.pop_back();
+        return reuse;
+      }
+    }
+    return std::make_shared<DepthSnapshot>();
+  }
+
+  Ptr current_;
+  std::vector<std::shared_ptr<DepthSnapshot> > retired_; // matching thread only
+};
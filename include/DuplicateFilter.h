@@ -0,0 +1,195 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: DuplicateFilter
+ * ============================================================================
+ * Detects client orders that were already submitted on this session.
+ *
+ * After a reconnect, a client often re-sends ("retransmits") orders it is not
+ * sure we received. Without a check, the same order could trade twice.
+ *
+ * Two layers, both with fixed memory no matter how long the session runs:
+ * - Recent window: an exact hash set of the last N order keys. Almost all
+ *   retransmissions land here.
+ * - Session Bloom filter: remembers every key seen this session in a fixed
+ *   bit array. It never misses a repeat, but can report a key it has not
+ *   seen (a "false positive"), so its answer is reported separately and
+ *   must not be treated as proof: the gateway lets such orders through and
+ *   flags them.
+ *
+ * The Bloom filter is sized from the number of orders a session is
+ * expected to send and the false-positive rate wanted at that volume.
+ * Past that volume the rate climbs (a fixed array fills up), so size it
+ * for the busiest session, not the average one.
+ *
+ * Keys are 64-bit hashes of (session, ClOrdID), see ClOrdIdInterner::hash().
+ */
+class DuplicateFilter {
+public:
+  enum Result {
+    NEW_ORDER,          // never seen on this session
+    DUPLICATE,          // exact match inside the recent window
+    POSSIBLE_DUPLICATE  // outside the window, Bloom filter says seen before
+  };
+
+  /**
+   * @param window_size          how many recent keys are tracked exactly
+   * @param expected_keys        keys the session is expected to send
+   * @param false_positive_rate  POSSIBLE_DUPLICATE rate for new keys once
+   *                             expected_keys have been seen
+   */
+  explicit DuplicateFilter(size_t window_size = 65536,
+                           size_t expected_keys = size_t(1) << 20,
+                           double false_positive_rate = 1e-3)
+      : window_(window_size ? window_size : 1, 0) {
+    size_t capacity = 16;
+    while (capacity < window_.size() * 2) {
+      capacity <<= 1;
+    }
+    recent_.assign(capacity, 0);
+    recent_mask_ = capacity - 1;
+
+    size_t bits = bloom_bits_for(expected_keys, false_positive_rate);
+    bloom_.assign(bits / 64, 0);
+    bloom_mask_ = bits - 1;
+    bloom_hashes_ = bloom_hashes_for(bits, expected_keys);
+  }
+
+  /**
+   * Bloom filter size for `keys` keys at false-positive rate `rate`:
+   * -keys * ln(rate) / ln(2)^2 bits, rounded up to a power of two.
+   */
+  static size_t bloom_bits_for(size_t keys, double rate) {
+    if (keys == 0) {
+      keys = 1;
+    }
+    if (!(rate > 0.0 && rate < 1.0)) {
+      rate = 1e-3;
+    }
+    const double ln2 = 0.6931471805599453;
+    double wanted = -double(keys) * std::log(rate) / (ln2 * ln2);
+    size_t bits = 64;
+    while (double(bits) < wanted) {
+      bits <<= 1;
+    }
+    return bits;
+  }
+
+  /// Best number of bits set per key: bits / keys * ln(2), from 1 to 16
+  static unsigned bloom_hashes_for(size_t bits, size_t keys) {
+    double k = double(bits) / double(keys ? keys : 1) * 0.6931471805599453;
+    return k < 1.0 ? 1 : k > 16.0 ? 16 : unsigned(k + 0.5);
+  }
+
+  /**
+   * Check a key and remember it.
+   *
+   * A NEW_ORDER or POSSIBLE_DUPLICATE key is recorded in the window and
+   * the Bloom filter. A DUPLICATE key is already in the window and is not
+   * recorded again (its place in the window is not refreshed).
+   *
+   * @param key  hash of (session, ClOrdID); 0 is remapped internally
+   */
+  Result check_and_insert(uint64_t key) {
+    if (key == 0) {
+      key = 1; // 0 marks an empty slot
+    }
+    if (recent_contains(key)) {
+      return DUPLICATE;
+    }
+    bool seen = bloom_test_and_set(key);
+    remember(key);
+    return seen ? POSSIBLE_DUPLICATE : NEW_ORDER;
+  }
+
+  /// @return number of keys currently in the exact window
+  size_t window_count() const { return count_; }
+
+  /// @return bits in the Bloom filter
+  size_t bloom_bits() const { return bloom_mask_ + 1; }
+
+  /// @return bits set per key
+  unsigned bloom_hashes() const { return bloom_hashes_; }
+
+private:
+  bool recent_contains(uint64_t key) const {
+    size_t pos = key & recent_mask_;
+    while (recent_[pos] != 0) {
+      if (recent_[pos] == key) {
+        return true;
+      }
+      pos = (pos + 1) & recent_mask_;
+    }
+    return false;
+  }
+
+  void recent_insert(uint64_t key) {
+    size_t pos = key & recent_mask_;
+    while (recent_[pos] != 0) {
+      pos = (pos + 1) & recent_mask_;
+    }
+    recent_[pos] = key;
+  }
+
+  /// Backward-shift deletion, same scheme as ClOrdIdInterner
+  void recent_erase(uint64_t key) {
+    size_t hole = key & recent_mask_;
+    while (recent_[hole] != key) {
+      if (recent_[hole] == 0) {
+        return;
+      }
+      hole = (hole + 1) & recent_mask_;
+    }
+    size_t next = (hole + 1) & recent_mask_;
+    while (recent_[next] != 0) {
+      size_t home = recent_[next] & recent_mask_;
+      if (((next - home) & recent_mask_) >= ((next - hole) & recent_mask_)) {
+        recent_[hole] = recent_[next];
+        hole = next;
+      }
+      next = (next + 1) & recent_mask_;
+    }
+    recent_[hole] = 0;
+  }
+
+  /// Add the key to the window, evicting the oldest key once it is full
+  void remember(uint64_t key) {
+    if (count_ == window_.size()) {
+      recent_erase(window_[head_]);
+    } else {
+      ++count_;
+    }
+    window_[head_] = key;
+    recent_insert(key);
+    head_ = head_ + 1 == window_.size() ? 0 : head_ + 1;
+  }
+
+  /// Double hashing: all probe positions derive from the one 64-bit key
+  bool bloom_test_and_set(uint64_t key) {
+    uint64_t h1 = key;
+    uint64_t h2 = (key >> 32 | key << 32) | 1;
+    bool seen = true;
+    for (unsigned i = 0; i < bloom_hashes_; ++i) {
+      uint64_t bit = (h1 + i * h2) & bloom_mask_;
+      uint64_t &word = bloom_[bit >> 6];
+      uint64_t flag = uint64_t(1) << (bit & 63);
+      seen = seen && (word & flag) != 0;
+      word |= flag;
+    }
+    return seen;
+  }
+
+  std::vector<uint64_t> window_; // ring buffer, oldest key at head_
+  std::vector<uint64_t> recent_; // open-addressing set over window_
+  std::vector<uint64_t> bloom_;
+  size_t recent_mask_ = 0;
+  uint64_t bloom_mask_ = 0;
+  unsigned bloom_hashes_ = 1;
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
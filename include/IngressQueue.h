@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: IngressQueue
+ * ============================================================================
+ * Queue of client messages waiting for the matching thread, with two lanes.
+ *
+ * - Priority lane: cancels and mass cancels
+ * - Normal lane:   new orders and replaces
+ *
+ * pop() always empties the priority lane first. Under load, a cancel never
+ * waits behind a backlog of new orders: taking risk off the book fast
+ * matters more than adding it.
+ *
+ * Both lanes are fixed-size ring buffers allocated up front.
+ *
+ * @tparam Message  the queued message type (copied in and out)
+ */
+template <class Message> class IngressQueue {
+public:
+  /**
+   * @param normal_capacity    max queued new orders/replaces
+   * @param priority_capacity  max queued cancels
+   */
+  IngressQueue(size_t normal_capacity, size_t priority_capacity)
+      : normal_(normal_capacity), priority_(priority_capacity) {}
+
+  /// @return false if the normal lane is full
+  bool push(const Message &msg) { return normal_.push(msg); }
+
+  /// @return false if the priority lane is full
+  bool push_priority(const Message &msg) { return priority_.push(msg); }
+
+  /**
+   * Take the next message, priority lane first.
+   * @return false if both lanes are empty
+   */
+  bool pop(Message &msg) { return priority_.pop(msg) || normal_.pop(msg); }
+
+  bool empty() const { return priority_.size() == 0 && normal_.size() == 0; }
+  size_t size() const { return priority_.size() + normal_.size(); }
+  size_t priority_size() const { return priority_.size(); }
+
+private:
+  class Ring {
+  public:
+    explicit Ring(size_t capacity)
+        : slots_(capacity ? capacity : 1), head_(0), count_(0) {}
+
+    bool push(const Message &msg) {
+      if (count_ == slots_.size()) {
+        return false;
+      }
+      size_t tail = head_ + count_;
+      if (tail >= slots_.size()) {
+        tail -= slots_.size();
+      }
+      slots_[tail] = msg;
+      ++count_;
+      return true;
+    }
+
+    bool pop(Message &msg) {
+      if (count_ == 0) {
+        return false;
+      }
+      msg = slots_[head_];
+      head_ = head_ + 1 == slots_.size() ? 0 : head_ + 1;
+      --count_;
+      return true;
+    }
+
+    size_t size() const { return count_; }
+
+  private:
+    std::vector<Message> slots_;
+    size_t head_;
+    size_t count_;
+  };
+
+  Ring normal_;
+  Ring priority_;
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: LatencyHistogram
+ * ============================================================================
+ * Records latencies (any integer unit, usually nanoseconds) with a fixed
+ * relative precision, in the style of HdrHistogram.
+ *
+ * Buckets are log-linear: values below 2048 each get their own counter;
+ * above that, every power of two is split into 1024 equal counters. Any
+ * recorded value is therefore known to within 0.1% (three significant
+ * digits), from 1 ns to an hour, in a fixed array of counters:
+ *
+ * - record() is a few instructions and never allocates;
+ * - percentiles are exact to that precision, including the far tail
+ *   (p99.99, max), which is what averages and sampled latencies hide;
+ * - histograms from several threads or runs add() together.
+ *
+ * print() writes the HdrHistogram "percentile distribution" text format,
+ * so the output can be plotted with the usual HdrHistogram tools.
+ */
+class LatencyHistogram {
+public:
+  /// @param max_value  largest value tracked; larger ones count as this
+  explicit LatencyHistogram(uint64_t max_value = 3600000000000ULL)
+      : max_value_(max_value < SUB_BUCKETS ? SUB_BUCKETS : max_value),
+        counts_(index_of(max_value_) + 1, 0) {
+    reset();
+  }
+
+  void record(uint64_t value, uint64_t count = 1) {
+    if (value > max_value_) {
+      value = max_value_;
+    }
+    counts_[index_of(value)] += count;
+    total_ += count;
+    sum_ += double(value) * double(count);
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  /// Add every value recorded in `other` (same max_value)
+  void add(const LatencyHistogram &other) {
+    for (size_t i = 0; i < counts_.size() && i < other.counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  void reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    sum_ = 0;
+    min_ = ~uint64_t(0);
+    max_ = 0;
+  }
+
+  uint64_t count() const { return total_; }
+  uint64_t min() const { return total_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? sum_ / double(total_) : 0.0; }
+
+  /**
+   * @param percentile  0-100, e.g. 99.9
+   * @return the smallest value that `percentile`% of recordings are at
+   *         or below (to 0.1%)
+   */
+  uint64_t percentile(double percentile) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    uint64_t rank = uint64_t(percentile / 100.0 * double(total_) + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(highest_of(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  /// @return how many recorded values are at or above `value` (to 0.1%)
+  uint64_t count_at_or_above(uint64_t value) const {
+    size_t first = index_of(std::min(value, max_value_));
+    uint64_t below = 0;
+    for (size_t i = 0; i < first; ++i) {
+      below += counts_[i];
+    }
+    return total_ - below;
+  }
+
+  /**
+   * Write the percentile distribution in HdrHistogram's text format.
+   *
+   * @param scale  divide values by this for output (1000 = ns to us)
+   * @param ticks_per_half  rows per halving of the remaining tail
+   */
+  void print(std::ostream &out, double scale = 1.0,
+             int ticks_per_half = 5) const {
+    out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile"
+        << " " << std::setw(10) << "TotalCount" << " " << std::setw(14)
+        << "1/(1-Percentile)" << "\n\n";
+    out << std::fixed;
+    if (total_ != 0) {
+      double next = 0;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i] == 0) {
+          continue;
+        }
+        seen += counts_[i];
+        double reached = 100.0 * double(seen) / double(total_);
+        if (reached < next && seen != total_) {
+          continue;
+        }
+        uint64_t value = std::min(highest_of(i), max_);
+        out << std::setw(12) << std::setprecision(3) << value / scale << " "
+            << std::setw(14) << std::setprecision(12) << reached / 100.0
+            << " " << std::setw(10) << seen;
+        if (seen != total_) {
+          out << " " << std::setw(14) << std::setprecision(2)
+              << 100.0 / (100.0 - reached);
+        }
+        out << "\n";
+        // Rows get denser toward the tail: ticks_per_half rows between
+        // 0% and 50%, as many again between 50% and 75%, and so on
+        double remaining = 100.0 - reached;
+        double level = 100.0;
+        while (level >= remaining && level > 1e-12) {
+          level /= 2;
+        }
+        next = reached + level / ticks_per_half;
+      }
+    }
+    out << std::setprecision(3) << "#[Mean    = " << std::setw(12)
+        << mean() / scale << ", StdDeviation   = " << std::setw(12)
+        << stddev() / scale << "]\n"
+        << "#[Max     = " << std::setw(12) << max() / scale
+        << ", Total count    = " << std::setw(12) << total_ << "]\n"
+        << "#[Buckets = " << std::setw(12) << counts_.size()
+        << ", SubBuckets     = " << std::setw(12) << SUB_BUCKETS << "]\n";
+  }
+
+private:
+  static const unsigned SUB_BITS = 11;
+  static const uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BITS; // 2048
+  static const uint64_t HALF = SUB_BUCKETS / 2;
+
+  static unsigned msb(uint64_t value) { return 63 - __builtin_clzll(value); }
+
+  /// Values below 2048 map to themselves; above, each power of two
+  /// [2^k, 2^(k+1)) is split into 1024 counters
+  static size_t index_of(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return size_t(value);
+    }
+    unsigned shift = msb(value) - (SUB_BITS - 1);
+    uint64_t sub = value >> shift; // in [HALF, SUB_BUCKETS)
+    return size_t(SUB_BUCKETS + (shift - 1) * HALF + (sub - HALF));
+  }
+
+  /// @return the largest value that maps to counter `index`
+  static uint64_t highest_of(size_t index) {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+    unsigned shift = unsigned((index - SUB_BUCKETS) / HALF) + 1;
+    uint64_t sub = HALF + (index - SUB_BUCKETS) % HALF;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  double stddev() const {
+    if (total_ == 0) {
+      return 0;
+    }
+    double m = mean();
+    double squares = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      if (counts_[i] != 0) {
+        double d = double(std::min(highest_of(i), max_)) - m;
+        squares += d * d * double(counts_[i]);
+      }
+    }
+    return std::sqrt(squares / double(total_));
+  }
+
+  uint64_t max_value_;
+  std::vector<uint64_t> counts_;
+  uint64_t total_;
+  double sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
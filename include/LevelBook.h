@@ -0,0 +1,1295 @@
+#pragma once
+#include <BookCallbacks.h>
+#include <NodePool.h>
+#include <OrderFlags.h>
+#include <OrderIndex.h>
+#include <PriceLevel.h>
+#include <TradingSession.h>
+#include <book/order_listener.h>
+#include <book/types.h>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * How an aggressive order's quantity is shared among the resting orders at
+ * a price level.
+ */
+enum MatchPolicy {
+  MATCH_FIFO,              // price-time: oldest order fills first
+  MATCH_PRO_RATA,          // in proportion to each resting order's size
+  MATCH_PRO_RATA_TOP_ORDER // oldest order fills first, rest pro-rata
+};
+
+/**
+ * What to do with a post-only order that would trade on arrival.
+ */
+enum PostOnlyMode {
+  POST_ONLY_REJECT, // reject it
+  POST_ONLY_REPRICE // move it one tick behind the contra best price
+};
+
+struct AskSide;
+
+/**
+ * The sides of a book as types. LevelBook picks one once, when an order
+ * enters, and everything below that point (matching, level lookups, depth
+ * updates) is compiled separately for each side. The price comparisons
+ * that differ between buys and sells are then fixed in the code instead
+ * of branching on is_buy() at every level the match loop visits.
+ */
+struct BidSide {
+  typedef liquibook::book::Price Price;
+  typedef AskSide Contra;
+  typedef std::greater<Price> Compare; // best level first
+  static const bool IS_BUY = true;
+
+  /// Can a buy limited at `limit` trade with a sell resting at `level`?
+  /// A market buy (price 0) reaches every level.
+  static bool crosses(Price limit, Price level) {
+    return level <= limit || limit == liquibook::book::MARKET_ORDER_PRICE;
+  }
+  /// Is `price` at or better than `than` for a buyer?
+  static bool at_or_better(Price price, Price than) { return price >= than; }
+  /// Price one tick behind the contra best, for a post-only buy
+  /// @return false if there is no such price
+  static bool behind(Price contra_best, Price tick, Price &price) {
+    if (contra_best <= tick) {
+      return false;
+    }
+    price = contra_best - tick;
+    return true;
+  }
+};
+
+struct AskSide {
+  typedef liquibook::book::Price Price;
+  typedef BidSide Contra;
+  typedef std::less<Price> Compare; // best level first
+  static const bool IS_BUY = false;
+
+  /// Can a sell limited at `limit` trade with a buy resting at `level`?
+  /// A market sell (price 0) reaches every level without a special case.
+  static bool crosses(Price limit, Price level) { return level >= limit; }
+  static bool at_or_better(Price price, Price than) { return price <= than; }
+  static bool behind(Price contra_best, Price tick, Price &price) {
+    price = contra_best + tick;
+    return true;
+  }
+};
+
+/**
+ * Best bid and offer: the top of the displayed book.
+ * A quantity of 0 means that side is empty.
+ */
+struct Bbo {
+  liquibook::book::Price bid_price = 0;
+  liquibook::book::Quantity bid_qty = 0;
+  liquibook::book::Price ask_price = 0;
+  liquibook::book::Quantity ask_qty = 0;
+
+  /// @return true if both a bid and an ask are showing
+  bool two_sided() const { return bid_qty != 0 && ask_qty != 0; }
+
+  bool operator==(const Bbo &other) const {
+    return bid_price == other.bid_price && bid_qty == other.bid_qty &&
+           ask_price == other.ask_price && ask_qty == other.ask_qty;
+  }
+  bool operator!=(const Bbo &other) const { return !(*this == other); }
+};
+
+/**
+ * Where a resting order stands in the book (see LevelBook::order_status()).
+ */
+struct OrderStatus {
+  bool is_buy = false;
+  bool hidden = false;
+  liquibook::book::Price price = 0;
+  liquibook::book::Quantity open_qty = 0;
+  /// Quantity at the same price that trades before this order in time
+  /// priority (for a hidden order, all displayed quantity is ahead too)
+  liquibook::book::Quantity qty_ahead = 0;
+};
+
+/**
+ * Signals derived from the top of the displayed book, kept up to date by
+ * LevelBook so consumers don't each recompute them from full depth.
+ * "Top N" is LevelBook::set_signal_depth() levels per side.
+ */
+struct BookSignals {
+  liquibook::book::Quantity bid_depth = 0; // displayed qty, top N bids
+  liquibook::book::Quantity ask_depth = 0; // displayed qty, top N asks
+  /// (bid_depth - ask_depth) / (bid_depth + ask_depth), in [-1, 1];
+  /// positive = more buying interest
+  double imbalance = 0;
+  /// Middle of the top-N volume-weighted bid and ask prices
+  /// (0 unless both sides are showing)
+  double weighted_mid = 0;
+  /// Top-of-book mid leaning toward the side with less quantity:
+  /// (bid * ask_qty + ask * bid_qty) / (bid_qty + ask_qty)
+  double microprice = 0;
+
+  bool operator==(const BookSignals &other) const {
+    return bid_depth == other.bid_depth && ask_depth == other.ask_depth &&
+           imbalance == other.imbalance &&
+           weighted_mid == other.weighted_mid &&
+           microprice == other.microprice;
+  }
+  bool operator!=(const BookSignals &other) const { return !(*this == other); }
+};
+
+/**
+ * Notified after perform_callbacks() when a book's BBO has changed.
+ *
+ * @tparam Book  the book type reporting the change
+ */
+template <class Book> class BboChangeListener {
+public:
+  virtual ~BboChangeListener() {}
+  virtual void on_bbo_change(const Book *book, const Bbo &bbo) = 0;
+  /// Top-N signals changed; delivered right after any BBO change
+  virtual void on_signals_change(const Book *, const BookSignals &) {}
+};
+
+/**
+ * ============================================================================
+ * CLASS: LevelBook
+ * ============================================================================
+ * An order book with the same interface as Liquibook's OrderBook (add,
+ * cancel, replace, perform_callbacks, the same OrderListener), but whose
+ * price levels we own, so the matching policy can be chosen per symbol.
+ *
+ * - MATCH_FIFO behaves like Liquibook: at each price, the oldest order
+ *   trades first (see example 4, scenario 6).
+ * - MATCH_PRO_RATA splits the incoming quantity across all orders at the
+ *   level by size: an order that is 30% of the level gets 30% of the fill.
+ *   Futures exchanges use this to reward size rather than speed.
+ * - MATCH_PRO_RATA_TOP_ORDER first fills the order that opened the level,
+ *   then shares the rest pro-rata.
+ *
+ * Supported orders: limit, market (never rests), IOC, fill-or-kill, hidden
+ * and post-only. Stop orders and resting all-or-none orders are rejected.
+ *
+ * - Hidden orders trade like any other but are never shown in depth. They
+ *   rest in their own queue at each level, behind the displayed orders.
+ * - Minimum-quantity orders must execute at least min_qty() on arrival,
+ *   or they are canceled without trading, whether or not anything crosses
+ *   (resting one without trading could lock or cross the book). The
+ *   check uses level totals, so an infeasible order costs O(levels), not
+ *   a walk over resting orders. The minimum applies on entry only: once
+ *   it has been met, whatever is left trades or rests like any other
+ *   order.
+ * - Post-only orders must add liquidity. If one would trade on arrival it
+ *   is rejected or repriced (see PostOnlyMode); a replace that would make
+ *   it trade is rejected or repriced the same way. The check compares
+ *   against the contra best price only, before any level is walked.
+ *
+ * Each book has a trading state (see TradingSession.h). Orders match only
+ * in STATE_CONTINUOUS. During an auction they rest without matching (the
+ * book may cross), and entering continuous trading or the close uncrosses
+ * the book at a single price, even if the auction was halted first. In any
+ * other state new orders are rejected.
+ *
+ * Orders are DAY orders unless good_till_cancel() is true. Moving to
+ * STATE_CLOSED cancels every DAY order in one bulk purge (see
+ * purge_day_orders()).
+ *
+ * Like Liquibook, events are queued and delivered by perform_callbacks().
+ * If the displayed BBO changed, the BBO listener is told last. Give
+ * set_order_listener() an EnvelopeListener to also get each event's
+ * EventEnvelope (ingress and match time, sequence number, shard).
+ *
+ * The book also keeps BookSignals (imbalance, weighted mid, microprice)
+ * over the top N displayed levels. Each change to displayed quantity is
+ * compared against the Nth price seen at the last refresh; only changes
+ * inside the top N mark the signals for a refresh, which happens once per
+ * operation and walks just N levels per side.
+ *
+ * Price levels come and go all day, so the book recycles them: the level
+ * maps take their nodes from a NodePool, and an emptied level's queue
+ * arrays are kept for the next new level. Once warm, adding and removing
+ * levels doesn't allocate.
+ *
+ * An order's side is looked at once, on entry (add, cancel, replace);
+ * past that point the code is instantiated per side (see BidSide), so
+ * the match loop has no buy/sell branches. Its conditions are decoded
+ * then too (see OrderFlags.h), and plain limit orders, most of the flow,
+ * take a path that skips every condition check.
+ *
+ * A sweep through deep levels removes the orders it filled from the
+ * index in one prefetching pass at the end, not one cache miss at a
+ * time, and starts loading the next level's queues when the current one
+ * can't fill the order (see set_prefetch_distance()).
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr> class LevelBook {
+public:
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef liquibook::book::OrderConditions OrderConditions;
+  typedef liquibook::book::OrderListener<OrderPtr> TypedOrderListener;
+  typedef EnvelopeListener<OrderPtr> TypedEnvelopeListener;
+  typedef PriceLevel<OrderPtr> Level;
+  typedef NodePoolAllocator<std::pair<const Price, Level> > LevelAllocator;
+  typedef std::map<Price, Level, BidSide::Compare, LevelAllocator> Bids;
+  typedef std::map<Price, Level, AskSide::Compare, LevelAllocator> Asks;
+  typedef BboChangeListener<LevelBook> TypedBboListener;
+
+  /**
+   * @param symbol  instrument symbol
+   * @param policy  matching policy for this symbol
+   * @param state   initial trading state
+   */
+  explicit LevelBook(const std::string &symbol = "unknown",
+                     MatchPolicy policy = MATCH_FIFO,
+                     SessionState state = STATE_CONTINUOUS)
+      : symbol_(symbol), policy_(policy), post_only_mode_(POST_ONLY_REJECT),
+        tick_size_(1), state_(state), listener_(NULL),
+        bbo_listener_(NULL), bbo_changed_(false), signal_depth_(5),
+        signals_dirty_(false), signals_changed_(false), prefetch_distance_(8),
+        bids_(BidSide::Compare(), LevelAllocator()),
+        asks_(AskSide::Compare(), bids_.get_allocator()) {}
+
+  const std::string &symbol() const { return symbol_; }
+  MatchPolicy policy() const { return policy_; }
+  void set_policy(MatchPolicy policy) { policy_ = policy; }
+
+  /**
+   * @param mode       reject or reprice crossing post-only orders
+   * @param tick_size  price increment used when repricing
+   */
+  void set_post_only_mode(PostOnlyMode mode, Price tick_size = 1) {
+    post_only_mode_ = mode;
+    tick_size_ = tick_size ? tick_size : 1;
+  }
+
+  SessionState state() const { return state_; }
+
+  /**
+   * Move the book to a new trading state.
+   *
+   * Entering continuous trading or the close from any other state runs
+   * the auction uncross: every order that crosses trades at one price.
+   * That covers an auction that was halted before it ended (e.g.
+   * OPENING_AUCTION -> HALTED -> CONTINUOUS), which leaves the book
+   * crossed just the same. Entering STATE_CLOSED then purges the DAY
+   * orders.
+   *
+   * @return false if the transition is not allowed (state unchanged)
+   */
+  bool set_state(SessionState state) {
+    if (!valid_transition(state_, state)) {
+      return false;
+    }
+    SessionState from = state_;
+    state_ = state;
+    if (from != STATE_CONTINUOUS &&
+        (state == STATE_CONTINUOUS || state == STATE_CLOSED)) {
+      uncross();
+      signals_dirty_ = true;
+    }
+    if (state == STATE_CLOSED) {
+      purge_day();
+    }
+    finish();
+    return true;
+  }
+
+  void set_order_listener(TypedOrderListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(NULL);
+  }
+
+  /// Same, and stamp every event with an EventEnvelope for `listener`
+  void set_order_listener(TypedEnvelopeListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(listener);
+  }
+
+  /**
+   * @param shard     shard ID for event envelopes
+   * @param sequence  event counter shared by the shard's books
+   */
+  void set_event_source(uint32_t shard, uint64_t *sequence) {
+    callbacks_.set_source(shard, sequence);
+  }
+
+  /// Ingress time of the next add/cancel/replace, for its envelopes
+  void set_ingress_time(uint64_t ns) { callbacks_.set_ingress_time(ns); }
+
+  void set_bbo_listener(TypedBboListener *listener) {
+    bbo_listener_ = listener;
+  }
+
+  TypedBboListener *bbo_listener() const { return bbo_listener_; }
+
+  /// @return the current displayed best bid and offer
+  const Bbo &bbo() const { return bbo_; }
+
+  /// @return the current top-N signals
+  const BookSignals &signals() const { return signals_; }
+
+  /// @param levels  levels per side that BookSignals cover (at least 1)
+  void set_signal_depth(size_t levels) {
+    signal_depth_ = levels ? levels : 1;
+    signals_dirty_ = true;
+    update_bbo();
+  }
+
+  /**
+   * @param orders  how far ahead the index cleanup after a sweep starts
+   *                loading the entries of the orders it filled, and
+   *                whether the sweep prefetches the next level's queues
+   *                (0 = no prefetching)
+   */
+  void set_prefetch_distance(size_t orders) { prefetch_distance_ = orders; }
+
+  /**
+   * Add an order: match what crosses, then rest the remainder.
+   *
+   * @param order       the order
+   * @param conditions  Liquibook order conditions, combined with the order's
+   *                    own all_or_none()/immediate_or_cancel() flags
+   * @return true if the order traded
+   */
+  bool add(const OrderPtr &order, OrderConditions conditions = 0) {
+    bool traded = add_order(order, conditions);
+    finish();
+    return traded;
+  }
+
+  /// Cancel a resting order
+  void cancel(const OrderPtr &order) {
+    cancel_order(order);
+    finish();
+  }
+
+  /**
+   * Change a resting order's quantity and/or price.
+   *
+   * Reducing quantity at the same price keeps time priority. A price
+   * change or size increase moves the order to the back of the queue, and
+   * a new price may trade immediately.
+   */
+  void replace(const OrderPtr &order,
+               int64_t size_delta = liquibook::book::SIZE_UNCHANGED,
+               Price new_price = liquibook::book::PRICE_UNCHANGED) {
+    replace_order(order, size_delta, new_price);
+    finish();
+  }
+
+  /**
+   * Cancel every resting DAY order at once (end of session).
+   *
+   * Instead of one cancel() per order, each price level is handled whole:
+   * the order arrays are scanned front to back, and the cancel reports go
+   * out as one batch on the next perform_callbacks(). If no GTC order is
+   * resting, nothing survives, so the levels and the order index are
+   * simply cleared without looking at the orders themselves.
+   *
+   * @return number of orders canceled
+   */
+  size_t purge_day_orders() {
+    size_t canceled = purge_day();
+    finish();
+    return canceled;
+  }
+
+  /**
+   * Cancel every resting order for which `pred(order)` is true, e.g. all
+   * of one session's orders. Same bulk path as purge_day_orders(): levels
+   * are filtered in place and the reports go out as one batch.
+   *
+   * @return number of orders canceled
+   */
+  template <class Pred> size_t cancel_where(Pred pred) {
+    size_t canceled = cancel_matching(pred, false);
+    finish();
+    return canceled;
+  }
+
+  /**
+   * Status of a resting order, including its queue position: how much
+   * quantity at its price is ahead of it. O(log n) in the level's queue
+   * length (see OrderQueue::qty_ahead()). Under pro-rata matching
+   * this is the time-priority position, not a fill prediction.
+   *
+   * @return false if the order is not resting in this book
+   */
+  bool order_status(const OrderPtr &order, OrderStatus &status) const {
+    const Location *where = locations_.find(order);
+    if (where == NULL) {
+      return false;
+    }
+    const Level &level = where->is_buy ? bids_.find(where->price)->second
+                                       : asks_.find(where->price)->second;
+    const Queue &queue = where->hidden ? level.hidden : level.lit;
+    status.is_buy = where->is_buy;
+    status.hidden = where->hidden;
+    status.price = where->price;
+    status.open_qty = queue.open_qty[where->slot];
+    status.qty_ahead = queue.qty_ahead(where->slot);
+    if (where->hidden) {
+      status.qty_ahead += level.displayed_qty();
+    }
+    return true;
+  }
+
+  /// @return number of resting orders
+  size_t resting_count() const { return locations_.size(); }
+
+  /// Deliver queued events to the listeners
+  void perform_callbacks() {
+    callbacks_.perform(listener_);
+    if (bbo_changed_) {
+      bbo_changed_ = false;
+      if (bbo_listener_ != NULL) {
+        bbo_listener_->on_bbo_change(this, bbo_);
+      }
+    }
+    if (signals_changed_) {
+      signals_changed_ = false;
+      if (bbo_listener_ != NULL) {
+        bbo_listener_->on_signals_change(this, signals_);
+      }
+    }
+  }
+
+  const Bids &bids() const { return bids_; }
+  const Asks &asks() const { return asks_; }
+
+private:
+  typedef typename Level::Queue Queue;
+
+  /// Where a resting order sits
+  struct Location {
+    bool is_buy;
+    bool hidden;
+    bool gtc; // survives purge_day_orders()
+    Price price;
+    size_t slot; // in the lit or hidden queue
+  };
+
+  typedef OrderIndex<OrderPtr, Location> Locations;
+
+  /// Selects DAY orders for purge_day()
+  struct IsDayOrder {
+    bool operator()(const OrderPtr &order) const {
+      return !order->good_till_cancel();
+    }
+  };
+
+  size_t purge_day() {
+    if (locations_.empty()) {
+      return 0;
+    }
+    signals_dirty_ = true;
+    if (gtc_resting_ != 0) {
+      // GTC orders stay; rebuilding the index is cheaper than erasing
+      // nearly every entry one by one
+      return cancel_matching(IsDayOrder(), true);
+    }
+    // Every order goes: collect them, then drop the levels whole
+    const size_t before = locations_.size();
+    purged_.clear();
+    collect_all(bids_);
+    collect_all(asks_);
+    bids_.clear();
+    asks_.clear();
+    locations_.clear();
+    callbacks_.cancel_batch(purged_);
+    return before;
+  }
+
+  template <class Levels> void collect_all(const Levels &side) {
+    for (typename Levels::const_iterator it = side.begin(); it != side.end();
+         ++it) {
+      collect_live(it->second.lit);
+      collect_live(it->second.hidden);
+    }
+  }
+
+  void collect_live(const Queue &queue) {
+    for (size_t slot = queue.head; slot < queue.orders.size(); ++slot) {
+      if (queue.open_qty[slot] != 0) {
+        purged_.push_back(queue.orders[slot]);
+      }
+    }
+  }
+
+  /**
+   * Cancel the resting orders `cancel` selects, keeping the others in
+   * time priority.
+   *
+   * @param reindex  rebuild the order index from the survivors instead of
+   *                 erasing the canceled orders (when most of them go)
+   */
+  template <class Pred> size_t cancel_matching(Pred cancel, bool reindex) {
+    const size_t before = locations_.size();
+    signals_dirty_ = true;
+    purged_.clear();
+    if (reindex) {
+      locations_.clear();
+      gtc_resting_ = 0;
+    }
+    filter_levels(bids_, true, cancel, reindex);
+    filter_levels(asks_, false, cancel, reindex);
+    callbacks_.cancel_batch(purged_);
+    return before - locations_.size();
+  }
+
+  template <class Levels, class Pred>
+  void filter_levels(Levels &side, bool is_buy, Pred &cancel, bool reindex) {
+    typename Levels::iterator it = side.begin();
+    while (it != side.end()) {
+      Location where;
+      where.is_buy = is_buy;
+      where.price = it->first;
+      where.hidden = false;
+      filter_queue(it->second.lit, where, cancel, reindex);
+      where.hidden = true;
+      filter_queue(it->second.hidden, where, cancel, reindex);
+      if (it->second.empty()) {
+        erase_level(side, it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  template <class Pred>
+  void filter_queue(Queue &queue, Location &where, Pred &cancel,
+                    bool reindex) {
+    size_t out = 0;
+    for (size_t slot = queue.head; slot < queue.orders.size(); ++slot) {
+      Quantity open = queue.open_qty[slot];
+      if (open == 0) {
+        continue;
+      }
+      const OrderPtr order = queue.orders[slot];
+      if (cancel(order)) {
+        purged_.push_back(order);
+        if (!reindex) {
+          forget(order);
+        }
+        queue.total_qty -= open;
+        --queue.live;
+        continue;
+      }
+      if (reindex) {
+        where.slot = out;
+        where.gtc = order->good_till_cancel();
+        locations_[order] = where;
+        gtc_resting_ += where.gtc;
+      } else {
+        locations_.find(order)->slot = out;
+      }
+      queue.orders[out] = order;
+      queue.open_qty[out] = open;
+      ++out;
+    }
+    queue.orders.resize(out);
+    queue.open_qty.resize(out);
+    queue.head = 0;
+    queue.reindex();
+  }
+
+  bool add_order(const OrderPtr &order, OrderConditions conditions) {
+    if (state_ != STATE_CONTINUOUS) {
+      add_outside_continuous(order, conditions);
+      return false;
+    }
+    // Decode the order once; the one side branch is here, too: from here
+    // on, each side has its own code
+    const OrderFlags flags = order_flags(order, conditions);
+    return order->is_buy() ? add_order<BidSide>(order, flags, bids_, asks_)
+                           : add_order<AskSide>(order, flags, asks_, bids_);
+  }
+
+  template <class Side, class Levels, class Contra>
+  bool add_order(const OrderPtr &order, OrderFlags flags, Levels &side,
+                 Contra &contra) {
+    if (is_plain_limit(flags)) {
+      return add_limit<Side>(order, (flags & ORDER_HIDDEN) != 0, side, contra);
+    }
+    return add_conditional<Side>(order, flags, side, contra);
+  }
+
+  /// Plain limit order, most of the flow: match, then rest what's left
+  template <class Side, class Levels, class Contra>
+  bool add_limit(const OrderPtr &order, bool hidden, Levels &side,
+                 Contra &contra) {
+    const Quantity qty = order->order_qty();
+    if (qty == 0) {
+      callbacks_.reject(order, "size must be positive");
+      return false;
+    }
+    const Price price = order->price();
+    callbacks_.accept(order);
+    Quantity remaining = match<Side>(order, price, qty, contra);
+    if (remaining != 0) {
+      rest<Side>(side, order, hidden, price, remaining);
+    }
+    return remaining != qty;
+  }
+
+  /// Market, stop, IOC, all-or-none, post-only and min-qty orders
+  template <class Side, class Levels, class Contra>
+  bool add_conditional(const OrderPtr &order, OrderFlags flags, Levels &side,
+                       Contra &contra) {
+    const Quantity qty = order->order_qty();
+    Price price = order->price();
+    const bool aon = (flags & ORDER_AON) != 0;
+    const bool ioc = (flags & (ORDER_IOC | ORDER_MARKET)) != 0;
+
+    if (qty == 0) {
+      callbacks_.reject(order, "size must be positive");
+      return false;
+    }
+    if (flags & ORDER_STOP) {
+      callbacks_.reject(order, "stop orders are not supported");
+      return false;
+    }
+    if (aon && !ioc) {
+      callbacks_.reject(order, "all-or-none orders must be IOC");
+      return false;
+    }
+    bool repriced = false;
+    if (flags & ORDER_POST_ONLY) {
+      if (ioc) {
+        callbacks_.reject(order, "post-only orders can't be IOC");
+        return false;
+      }
+      if (post_only_crosses<Side>(contra, price)) {
+        if (post_only_mode_ == POST_ONLY_REJECT) {
+          callbacks_.reject(order, "post-only order would take liquidity");
+          return false;
+        }
+        if (!Side::behind(contra.begin()->first, tick_size_, price)) {
+          callbacks_.reject(order, "post-only order can't be repriced");
+          return false;
+        }
+        repriced = true;
+      }
+    }
+    callbacks_.accept(order);
+    if (repriced) {
+      // Tell the client where its order actually rests
+      callbacks_.replace(order, 0, price);
+    }
+
+    // Fill-or-kill and minimum quantity: check enough contra quantity is
+    // there, using level totals, before any fill is generated
+    Quantity required = aon ? qty : Quantity(order->min_qty());
+    if (required > qty) {
+      required = qty;
+    }
+    if (required != 0) {
+      // Same rule whether some, or nothing, crosses: cancel
+      if (crossing_qty<Side>(contra, price, required) < required) {
+        callbacks_.cancel(order);
+        return false;
+      }
+    }
+
+    Quantity remaining = match<Side>(order, price, qty, contra);
+    if (remaining != 0) {
+      if (ioc) {
+        callbacks_.cancel(order);
+      } else {
+        rest<Side>(side, order, (flags & ORDER_HIDDEN) != 0, price, remaining);
+      }
+    }
+    return remaining != qty;
+  }
+
+  /// Auctions collect plain limit orders; other states reject
+  void add_outside_continuous(const OrderPtr &order,
+                              OrderConditions conditions) {
+    if (!is_auction(state_)) {
+      callbacks_.reject(order, "symbol is not open for trading");
+      return;
+    }
+    if (order->order_qty() == 0) {
+      callbacks_.reject(order, "size must be positive");
+      return;
+    }
+    if (!is_plain_limit(order_flags(order)) || conditions != 0) {
+      callbacks_.reject(order, "only plain limit orders during an auction");
+      return;
+    }
+    callbacks_.accept(order);
+    if (order->is_buy()) {
+      rest<BidSide>(bids_, order, order->hidden(), order->price(),
+                    order->order_qty());
+    } else {
+      rest<AskSide>(asks_, order, order->hidden(), order->price(),
+                    order->order_qty());
+    }
+  }
+
+  void cancel_order(const OrderPtr &order) {
+    const Location *loc = locations_.find(order);
+    if (loc == NULL) {
+      callbacks_.cancel_reject(order, "not found");
+      return;
+    }
+    Location where = *loc;
+    if (where.is_buy) {
+      remove<BidSide>(bids_, where);
+    } else {
+      remove<AskSide>(asks_, where);
+    }
+    callbacks_.cancel(order);
+  }
+
+  void replace_order(const OrderPtr &order, int64_t size_delta,
+                     Price new_price) {
+    const bool matching = state_ == STATE_CONTINUOUS;
+    if (!matching && !is_auction(state_)) {
+      callbacks_.replace_reject(order, "symbol is not open for trading");
+      return;
+    }
+    const Location *loc = locations_.find(order);
+    if (loc == NULL) {
+      callbacks_.replace_reject(order, "not found");
+      return;
+    }
+    Location where = *loc;
+    if (where.is_buy) {
+      replace_order<BidSide>(order, where, size_delta, new_price, matching,
+                             bids_, asks_);
+    } else {
+      replace_order<AskSide>(order, where, size_delta, new_price, matching,
+                             asks_, bids_);
+    }
+  }
+
+  template <class Side, class Levels, class Contra>
+  void replace_order(const OrderPtr &order, const Location &where,
+                     int64_t size_delta, Price new_price, bool matching,
+                     Levels &side, Contra &contra) {
+    Quantity open = level_qty(side, where);
+    if (int64_t(open) + size_delta <= 0) {
+      callbacks_.replace_reject(order, "not enough open quantity");
+      return;
+    }
+    Quantity new_open = Quantity(int64_t(open) + size_delta);
+    Price price = new_price == liquibook::book::PRICE_UNCHANGED ? where.price
+                                                                : new_price;
+    // A post-only order must still add liquidity at its new price: same
+    // check, and same mode, as on entry
+    if (matching && order->post_only() &&
+        post_only_crosses<Side>(contra, price)) {
+      if (post_only_mode_ == POST_ONLY_REJECT) {
+        callbacks_.replace_reject(order,
+                                  "post-only order would take liquidity");
+        return;
+      }
+      if (contra.empty() ||
+          !Side::behind(contra.begin()->first, tick_size_, price)) {
+        callbacks_.replace_reject(order, "post-only order can't be repriced");
+        return;
+      }
+    }
+    callbacks_.replace(order, size_delta, price);
+
+    if (price == where.price && size_delta <= 0) {
+      Level &level = side.find(where.price)->second;
+      level.queue(where.hidden).reduce(where.slot, Quantity(-size_delta));
+      if (!where.hidden) {
+        touch<Side>(where.price);
+      }
+      return;
+    }
+
+    // Loses priority: take it out and bring it back in as if new
+    remove<Side>(side, where);
+    Quantity remaining =
+        matching ? match<Side>(order, price, new_open, contra) : new_open;
+    if (remaining != 0) {
+      rest<Side>(side, order, where.hidden, price, remaining);
+    }
+  }
+
+  /**
+   * Auction uncross: pick the price that trades the most quantity, then
+   * match every crossing order there, best price and time first.
+   *
+   * Ties on volume go to the smallest buy/sell imbalance, then the lower
+   * price, so the result is deterministic.
+   */
+  void uncross() {
+    if (bids_.empty() || asks_.empty() ||
+        bids_.begin()->first < asks_.begin()->first) {
+      return;
+    }
+
+    // Cumulative quantity available at each crossing price
+    std::vector<Price> bid_prices, ask_prices;
+    std::vector<Quantity> bid_cum, ask_cum; // bids: at or above; asks: at or below
+    Quantity total = 0;
+    for (typename Bids::const_iterator it = bids_.begin();
+         it != bids_.end() && it->first >= asks_.begin()->first; ++it) {
+      total += it->second.total_qty();
+      bid_prices.push_back(it->first);
+      bid_cum.push_back(total);
+    }
+    total = 0;
+    for (typename Asks::const_iterator it = asks_.begin();
+         it != asks_.end() && it->first <= bids_.begin()->first; ++it) {
+      total += it->second.total_qty();
+      ask_prices.push_back(it->first);
+      ask_cum.push_back(total);
+    }
+
+    Price best_price = 0;
+    Quantity best_volume = 0;
+    Quantity best_imbalance = 0;
+    std::vector<Price> candidates(bid_prices);
+    candidates.insert(candidates.end(), ask_prices.begin(), ask_prices.end());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      Price p = candidates[i];
+      // bid_prices is descending: count levels with price >= p
+      size_t nb = std::upper_bound(bid_prices.begin(), bid_prices.end(), p,
+                                   std::greater<Price>()) -
+                  bid_prices.begin();
+      size_t na = std::upper_bound(ask_prices.begin(), ask_prices.end(), p) -
+                  ask_prices.begin();
+      Quantity buy = nb ? bid_cum[nb - 1] : 0;
+      Quantity sell = na ? ask_cum[na - 1] : 0;
+      Quantity volume = buy < sell ? buy : sell;
+      Quantity imbalance = buy > sell ? buy - sell : sell - buy;
+      if (volume > best_volume ||
+          (volume == best_volume && volume != 0 &&
+           (imbalance < best_imbalance ||
+            (imbalance == best_imbalance && p < best_price)))) {
+        best_price = p;
+        best_volume = volume;
+        best_imbalance = imbalance;
+      }
+    }
+    if (best_volume == 0) {
+      return;
+    }
+
+    while (!bids_.empty() && !asks_.empty() &&
+           bids_.begin()->first >= best_price &&
+           asks_.begin()->first <= best_price) {
+      Level &bid = bids_.begin()->second;
+      Level &ask = asks_.begin()->second;
+      Queue &bq = bid.lit.empty() ? bid.hidden : bid.lit;
+      Queue &aq = ask.lit.empty() ? ask.hidden : ask.lit;
+      size_t b = bq.head;
+      size_t a = aq.head;
+      Quantity qty = bq.open_qty[b] < aq.open_qty[a] ? bq.open_qty[b]
+                                                     : aq.open_qty[a];
+      callbacks_.fill(bq.orders[b], aq.orders[a], qty, best_price);
+      if (bq.reduce(b, qty)) {
+        forget(bq.orders[b]);
+      }
+      if (aq.reduce(a, qty)) {
+        forget(aq.orders[a]);
+      }
+      if (bid.empty()) {
+        erase_level(bids_, bids_.begin());
+      }
+      if (ask.empty()) {
+        erase_level(asks_, asks_.begin());
+      }
+    }
+  }
+
+  /// Best price with displayed quantity (hidden-only levels are skipped)
+  template <class Levels>
+  static void best_displayed(const Levels &side, Price &price, Quantity &qty) {
+    price = 0;
+    qty = 0;
+    for (typename Levels::const_iterator it = side.begin(); it != side.end();
+         ++it) {
+      if (it->second.displayed_qty() != 0) {
+        price = it->first;
+        qty = it->second.displayed_qty();
+        return;
+      }
+    }
+  }
+
+  /// End of a public operation: refresh the BBO, close the event stamp
+  void finish() {
+    update_bbo();
+    callbacks_.end_operation();
+  }
+
+  /// Recompute the BBO (and signals, if due) after a book change; flag
+  /// whatever moved
+  void update_bbo() {
+    Bbo now;
+    best_displayed(bids_, now.bid_price, now.bid_qty);
+    best_displayed(asks_, now.ask_price, now.ask_qty);
+    if (now != bbo_) {
+      bbo_ = now;
+      bbo_changed_ = true;
+    }
+    if (signals_dirty_) {
+      refresh_signals();
+    }
+  }
+
+  /// Top N displayed levels of one side, as seen at the last refresh
+  struct TopLevels {
+    TopLevels() : levels(0), nth_price(0) {}
+    size_t levels;   // displayed levels counted (at most N)
+    Price nth_price; // price of the last one counted
+  };
+
+  const TopLevels &top_levels(BidSide) const { return bid_top_; }
+  const TopLevels &top_levels(AskSide) const { return ask_top_; }
+
+  /// Displayed quantity changed at `price`: due a refresh if in the top N
+  template <class Side> void touch(Price price) {
+    if (signals_dirty_) {
+      return;
+    }
+    const TopLevels &top = top_levels(Side());
+    signals_dirty_ = top.levels < signal_depth_ ||
+                     Side::at_or_better(price, top.nth_price);
+  }
+
+  /// Sum the top N displayed levels of one side
+  template <class Levels>
+  void sum_top(const Levels &side, TopLevels &top, Quantity &depth,
+               double &value) const {
+    top = TopLevels();
+    depth = 0;
+    value = 0;
+    for (typename Levels::const_iterator it = side.begin();
+         it != side.end() && top.levels < signal_depth_; ++it) {
+      Quantity qty = it->second.displayed_qty();
+      if (qty == 0) {
+        continue;
+      }
+      depth += qty;
+      value += double(it->first) * double(qty);
+      top.nth_price = it->first;
+      ++top.levels;
+    }
+  }
+
+  void refresh_signals() {
+    signals_dirty_ = false;
+    BookSignals now;
+    double bid_value, ask_value;
+    sum_top(bids_, bid_top_, now.bid_depth, bid_value);
+    sum_top(asks_, ask_top_, now.ask_depth, ask_value);
+    Quantity depth = now.bid_depth + now.ask_depth;
+    if (depth != 0) {
+      now.imbalance = (double(now.bid_depth) - double(now.ask_depth)) / depth;
+    }
+    if (bbo_.two_sided()) {
+      now.weighted_mid =
+          (bid_value / now.bid_depth + ask_value / now.ask_depth) / 2;
+      now.microprice = (double(bbo_.bid_price) * bbo_.ask_qty +
+                        double(bbo_.ask_price) * bbo_.bid_qty) /
+                       double(bbo_.bid_qty + bbo_.ask_qty);
+    }
+    if (now != signals_) {
+      signals_ = now;
+      signals_changed_ = true;
+    }
+  }
+
+  /// Post-only check: one comparison against the contra best price
+  template <class Side, class Levels>
+  static bool post_only_crosses(const Levels &contra, Price price) {
+    return price == liquibook::book::MARKET_ORDER_PRICE ||
+           (!contra.empty() && Side::crosses(price, contra.begin()->first));
+  }
+
+  /// Contra quantity an order could reach, stopping once `needed` is found
+  template <class Side, class Levels>
+  Quantity crossing_qty(const Levels &contra, Price price,
+                        Quantity needed) const {
+    Quantity available = 0;
+    for (typename Levels::const_iterator it = contra.begin();
+         it != contra.end() && available < needed; ++it) {
+      if (!Side::crosses(price, it->first)) {
+        break;
+      }
+      available += it->second.total_qty();
+    }
+    return available;
+  }
+
+  /**
+   * Match an inbound order on `Side` against the contra side, best level
+   * first.
+   * @return quantity left unfilled
+   */
+  template <class Side, class Levels>
+  Quantity match(const OrderPtr &order, Price price, Quantity qty,
+                 Levels &contra) {
+    while (qty != 0 && !contra.empty()) {
+      typename Levels::iterator it = contra.begin();
+      if (!Side::crosses(price, it->first)) {
+        break;
+      }
+      Level &level = it->second;
+      if (prefetch_distance_ != 0 && qty > level.total_qty()) {
+        // This level won't be enough: start loading the next one's queues
+        typename Levels::iterator next = it;
+        if (++next != contra.end()) {
+          prefetch(next->second.lit);
+          prefetch(next->second.hidden);
+        }
+      }
+      // Displayed orders first, then hidden orders at the same price
+      Quantity filled = fill_queue(order, level.price, level.lit, qty);
+      if (filled != 0) {
+        signals_dirty_ = true; // the best displayed level changed
+      }
+      if (filled < qty && !level.hidden.empty()) {
+        filled += fill_queue(order, level.price, level.hidden, qty - filled);
+      }
+      qty -= filled;
+      if (level.empty()) {
+        erase_level(contra, it);
+      } else {
+        compact(level.lit);
+        compact(level.hidden);
+      }
+    }
+    forget_filled();
+    return qty;
+  }
+
+  Quantity fill_queue(const OrderPtr &inbound, Price price, Queue &queue,
+                      Quantity qty) {
+    if (queue.empty()) {
+      return 0;
+    }
+    if (policy_ == MATCH_FIFO || qty >= queue.total_qty) {
+      return fill_fifo(inbound, price, queue, qty);
+    }
+    return fill_pro_rata(inbound, price, queue, qty);
+  }
+
+  /// Fill one slot; a resting order that is done is forgotten at the
+  /// end of the match (see forget_filled())
+  void fill_slot(const OrderPtr &inbound, Price price, Queue &queue,
+                 size_t slot, Quantity qty, bool update_tree = true) {
+    callbacks_.fill(inbound, queue.orders[slot], qty, price);
+    if (queue.reduce(slot, qty, update_tree)) {
+      filled_.push_back(queue.orders[slot]);
+    }
+  }
+
+  /**
+   * Drop the orders a match filled from the index.
+   *
+   * The queues are walked front to back, which the hardware prefetcher
+   * follows on its own; each order's index entry is at a random address.
+   * Removing them one by one, in the middle of the fill loop, waits on
+   * one of those cache misses per order. Done here, in a short loop that
+   * also prefetches prefetch_distance_ orders ahead, the misses overlap.
+   */
+  void forget_filled() {
+    const size_t count = filled_.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (prefetch_distance_ != 0 && i + prefetch_distance_ < count) {
+        locations_.prefetch(filled_[i + prefetch_distance_]);
+      }
+      forget(filled_[i]);
+    }
+    filled_.clear();
+  }
+
+  /// Start loading the front of a queue
+  static void prefetch(const Queue &queue) {
+    if (queue.head < queue.orders.size()) {
+      __builtin_prefetch(&queue.orders[queue.head]);
+      __builtin_prefetch(&queue.open_qty[queue.head]);
+    }
+  }
+
+  Quantity fill_fifo(const OrderPtr &inbound, Price price, Queue &queue,
+                     Quantity qty) {
+    Quantity filled = 0;
+    for (size_t slot = queue.head; slot < queue.orders.size() && filled < qty;
+         ++slot) {
+      Quantity open = queue.open_qty[slot];
+      if (open == 0) {
+        continue;
+      }
+      Quantity fill = open < qty - filled ? open : qty - filled;
+      fill_slot(inbound, price, queue, slot, fill);
+      filled += fill;
+    }
+    return filled;
+  }
+
+  /// Requires qty < queue.total_qty (otherwise everyone fills in full)
+  Quantity fill_pro_rata(const OrderPtr &inbound, Price price, Queue &queue,
+                         Quantity qty) {
+    Quantity filled = 0;
+    if (policy_ == MATCH_PRO_RATA_TOP_ORDER) {
+      size_t top = queue.head;
+      Quantity open = queue.open_qty[top];
+      Quantity fill = open < qty ? open : qty;
+      fill_slot(inbound, price, queue, top, fill);
+      filled = fill;
+      if (filled == qty) {
+        return filled;
+      }
+    }
+
+    const size_t begin = queue.head;
+    const size_t end = queue.orders.size();
+    if (alloc_.size() < end) {
+      alloc_.resize(end);
+    }
+    pro_rata_allocate(&queue.open_qty[0], &alloc_[0], begin, end,
+                      queue.total_qty, qty - filled);
+    // Nearly every slot changes: one O(n) queue reindex beats a
+    // tree update per fill
+    for (size_t slot = begin; slot < end; ++slot) {
+      if (alloc_[slot] != 0) {
+        fill_slot(inbound, price, queue, slot, alloc_[slot], false);
+      }
+    }
+    queue.reindex();
+    return qty;
+  }
+
+  template <class Side, class Levels>
+  void rest(Levels &side, const OrderPtr &order, bool hidden, Price price,
+            Quantity qty) {
+    typename Levels::iterator it = side.find(price);
+    if (it == side.end()) {
+      it = side.insert(std::make_pair(price, new_level(price))).first;
+    }
+    Location where;
+    where.is_buy = Side::IS_BUY;
+    where.hidden = hidden;
+    where.gtc = order->good_till_cancel();
+    where.price = price;
+    where.slot = it->second.queue(hidden).push_back(order, qty);
+    locations_[order] = where;
+    gtc_resting_ += where.gtc;
+    if (!hidden) {
+      touch<Side>(price);
+    }
+  }
+
+  /// Drop a filled or canceled order from the index
+  void forget(const OrderPtr &order) {
+    gtc_resting_ -= locations_.find(order)->gtc;
+    locations_.erase(order);
+  }
+
+  template <class Levels>
+  Quantity level_qty(Levels &side, const Location &where) const {
+    const Level &level = side.find(where.price)->second;
+    return (where.hidden ? level.hidden : level.lit).open_qty[where.slot];
+  }
+
+  /// Take a resting order out of its level
+  template <class Side, class Levels>
+  void remove(Levels &side, const Location &where) {
+    typename Levels::iterator it = side.find(where.price);
+    Level &level = it->second;
+    Queue &queue = level.queue(where.hidden);
+    forget(queue.orders[where.slot]);
+    queue.reduce(where.slot, queue.open_qty[where.slot]);
+    if (!where.hidden) {
+      touch<Side>(where.price);
+    }
+    if (level.empty()) {
+      erase_level(side, it);
+    } else {
+      compact(queue);
+    }
+  }
+
+  /// A level for a new price, reusing a spare level's arrays if any
+  Level new_level(Price price) {
+    if (spare_levels_.empty()) {
+      return Level(price);
+    }
+    Level level(std::move(spare_levels_.back()));
+    spare_levels_.pop_back();
+    level.price = price;
+    level.lit.clear();
+    level.hidden.clear();
+    return level;
+  }
+
+  /// Drop an empty level, keeping its arrays for new_level()
+  template <class Levels>
+  void erase_level(Levels &side, typename Levels::iterator it) {
+    if (spare_levels_.size() < MAX_SPARE_LEVELS) {
+      spare_levels_.push_back(std::move(it->second));
+    }
+    side.erase(it);
+  }
+
+  /// Drop a queue's dead slots once they are half of it. Counting the
+  /// holes that cancels leave mid-queue, not just the filled front, keeps
+  /// a long-lived level's arrays from growing without bound.
+  void compact(Queue &queue) {
+    if (queue.orders.size() < 64 || queue.live * 2 > queue.orders.size()) {
+      return;
+    }
+    size_t out = 0;
+    for (size_t slot = queue.head; slot < queue.orders.size(); ++slot) {
+      if (queue.open_qty[slot] == 0) {
+        continue;
+      }
+      queue.orders[out] = queue.orders[slot];
+      queue.open_qty[out] = queue.open_qty[slot];
+      locations_[queue.orders[out]].slot = out;
+      ++out;
+    }
+    queue.orders.resize(out);
+    queue.open_qty.resize(out);
+    queue.head = 0;
+    queue.reindex();
+  }
+
+  std::string symbol_;
+  MatchPolicy policy_;
+  PostOnlyMode post_only_mode_;
+  Price tick_size_;
+  SessionState state_; // checked first on every add
+  TypedOrderListener *listener_;
+  TypedBboListener *bbo_listener_;
+  Bbo bbo_;
+  bool bbo_changed_;
+  size_t signal_depth_; // N for BookSignals
+  BookSignals signals_;
+  TopLevels bid_top_;
+  TopLevels ask_top_;
+  bool signals_dirty_;   // a top-N level changed since the last refresh
+  bool signals_changed_; // signals_ moved since the last perform_callbacks()
+  size_t prefetch_distance_; // orders, see forget_filled()
+  Bids bids_;
+  Asks asks_;
+  Locations locations_;
+  size_t gtc_resting_ = 0; // 0 = a purge can drop everything unseen
+  CallbackQueue<OrderPtr> callbacks_;
+  std::vector<OrderPtr> purged_; // purge scratch, swapped into callbacks_
+  std::vector<Quantity> alloc_; // pro-rata scratch, reused across matches
+  std::vector<OrderPtr> filled_; // filled resting orders, see forget_filled()
+  static const size_t MAX_SPARE_LEVELS = 1024;
+  std::vector<Level> spare_levels_; // emptied levels, arrays kept
+};
+
+/// Lets OrderGateway pass ingress times to a LevelBook
+template <class OrderPtr>
+void set_ingress_time(LevelBook<OrderPtr> &book, uint64_t ns) {
+  book.set_ingress_time(ns);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/**
+ * ============================================================================
+ * CLASS: NodePool
+ * ============================================================================
+ * Keeps the freed nodes of a node-based container (std::map, std::set,
+ * std::list) for reuse instead of giving them back to malloc.
+ *
+ * A std::map allocates a node on every insert and frees it on every
+ * erase. A book whose price levels come and go all day would call malloc
+ * and free constantly. With a NodePool, an erased node goes onto a free
+ * list and the next insert takes it back, so once the map has reached its
+ * working size it never calls malloc again.
+ *
+ * The pool recycles blocks of one size: the first size it is asked for
+ * (the container's node). Anything else goes straight to operator new.
+ * Memory is returned only when the pool is destroyed.
+ *
+ * Not thread-safe: a pool belongs to the containers of one owner, used
+ * from one thread at a time.
+ */
+class NodePool {
+public:
+  NodePool() : free_(NULL), size_(0) {}
+
+  ~NodePool() {
+    while (free_ != NULL) {
+      Block *next = free_->next;
+      ::operator delete(free_);
+      free_ = next;
+    }
+  }
+
+  void *allocate(size_t size) {
+    if (size == size_ && free_ != NULL) {
+      Block *block = free_;
+      free_ = block->next;
+      return block;
+    }
+    if (size_ == 0 && size >= sizeof(Block)) {
+      size_ = size;
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void *ptr, size_t size) {
+    if (size != size_) {
+      ::operator delete(ptr);
+      return;
+    }
+    Block *block = static_cast<Block *>(ptr);
+    block->next = free_;
+    free_ = block;
+  }
+
+private:
+  NodePool(const NodePool &);
+  NodePool &operator=(const NodePool &);
+
+  struct Block {
+    Block *next;
+  };
+
+  Block *free_; // recycled blocks, most recently freed first
+  size_t size_; // block size recycled (0 = not yet known)
+};
+
+/**
+ * Standard allocator over a shared NodePool.
+ *
+ * Containers constructed from copies of one allocator share its pool
+ * (e.g. the bid and ask maps of a book). Copying a container gives the
+ * copy a new pool of its own, so two containers that go separate ways
+ * never share a free list.
+ *
+ * @tparam T  value type (the container rebinds it to its node type)
+ */
+template <class T> class NodePoolAllocator {
+public:
+  typedef T value_type;
+
+  NodePoolAllocator() : pool_(std::make_shared<NodePool>()) {}
+
+  template <class U>
+  NodePoolAllocator(const NodePoolAllocator<U> &other) : pool_(other.pool_) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(n == 1 ? pool_->allocate(sizeof(T))
+                                   : ::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *ptr, size_t n) {
+    if (n == 1) {
+      pool_->deallocate(ptr, sizeof(T));
+    } else {
+      ::operator delete(ptr);
+    }
+  }
+
+  NodePoolAllocator select_on_container_copy_construction() const {
+    return NodePoolAllocator();
+  }
+
+  template <class U> bool operator==(const NodePoolAllocator<U> &other) const {
+    return pool_ == other.pool_;
+  }
+  template <class U> bool operator!=(const NodePoolAllocator<U> &other) const {
+    return pool_ != other.pool_;
+  }
+
+private:
+  template <class U> friend class NodePoolAllocator;
+
+  std::shared_ptr<NodePool> pool_;
+};
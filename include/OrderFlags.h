@@ -0,0 +1,64 @@
+#pragma once
+#include <book/types.h>
+#include <cstdint>
+
+/**
+ * What kind of order an order is, decoded once from its accessors and
+ * the add() conditions so later code tests one small integer instead of
+ * calling stop_price(), all_or_none(), immediate_or_cancel() and the rest
+ * again.
+ *
+ * Most flow is plain limit orders: a limit price and nothing else. Those
+ * decode to PLAIN_LIMIT_ORDER (hidden and GTC don't count, they only
+ * choose where and how long an order rests), and LevelBook sends them down
+ * a path with no stop, all-or-none, IOC, post-only or min-qty logic at
+ * all.
+ */
+enum OrderFlag {
+  ORDER_MARKET = 1,     // price() is MARKET_ORDER_PRICE
+  ORDER_STOP = 2,       // stop_price() > 0
+  ORDER_AON = 4,        // all-or-none, from the order or the conditions
+  ORDER_IOC = 8,        // immediate-or-cancel, from the order or the conditions
+  ORDER_POST_ONLY = 16,
+  ORDER_MIN_QTY = 32,   // min_qty() > 0
+  ORDER_HIDDEN = 64,
+  ORDER_GTC = 128
+};
+
+/// OrderFlag bits
+typedef uint8_t OrderFlags;
+
+/// Flags that don't change how an order matches
+static const OrderFlags RESTING_FLAGS = ORDER_HIDDEN | ORDER_GTC;
+
+/// Decoded flags of a plain limit order (ignoring RESTING_FLAGS)
+static const OrderFlags PLAIN_LIMIT_ORDER = 0;
+
+/**
+ * @param order       order pointer (anything with SimpleOrder's accessors)
+ * @param conditions  Liquibook conditions passed to add()
+ */
+template <class OrderPtr>
+OrderFlags order_flags(const OrderPtr &order,
+                       liquibook::book::OrderConditions conditions = 0) {
+  return OrderFlags(
+      (order->price() == liquibook::book::MARKET_ORDER_PRICE ? ORDER_MARKET
+                                                             : 0) |
+      (order->stop_price() > 0 ? ORDER_STOP : 0) |
+      ((conditions & liquibook::book::oc_all_or_none) || order->all_or_none()
+           ? ORDER_AON
+           : 0) |
+      ((conditions & liquibook::book::oc_immediate_or_cancel) ||
+               order->immediate_or_cancel()
+           ? ORDER_IOC
+           : 0) |
+      (order->post_only() ? ORDER_POST_ONLY : 0) |
+      (order->min_qty() > 0 ? ORDER_MIN_QTY : 0) |
+      (order->hidden() ? ORDER_HIDDEN : 0) |
+      (order->good_till_cancel() ? ORDER_GTC : 0));
+}
+
+/// @return true if `flags` describe a plain limit order
+inline bool is_plain_limit(OrderFlags flags) {
+  return (flags & ~RESTING_FLAGS) == PLAIN_LIMIT_ORDER;
+}
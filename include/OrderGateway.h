@@ -0,0 +1,532 @@
+#pragma once
+#include <ClOrdIdInterner.h>
+#include <DuplicateFilter.h>
+#include <IngressQueue.h>
+#include <SimpleOrder.h>
+#include <TokenBucket.h>
+#include <TscClock.h>
+#include <book/order_book.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Per-session limits, fixed when the session logs on.
+ */
+struct SessionLimits {
+  uint64_t orders_per_second = 0; // new orders + replaces; 0 = unlimited
+  uint64_t burst = 1;             // orders allowed back-to-back
+  size_t window_size = 65536;     // recent ClOrdIDs checked exactly
+  /// Whole-session duplicate filter: sized for this many orders, with at
+  /// most this rate of false "possible duplicate" flags (the default is
+  /// 2 MB per session)
+  size_t expected_orders = size_t(1) << 20;
+  double max_false_positive = 1e-3;
+};
+
+/**
+ * Gateway counters. One set per session, plus a total over all sessions.
+ */
+struct GatewayMetrics {
+  uint64_t orders_in = 0;          // new orders + replaces received
+  uint64_t orders_throttled = 0;   // rejected by the token bucket
+  uint64_t duplicates_rejected = 0;
+  uint64_t possible_duplicates = 0; // let through, flagged on the order
+  uint64_t cancels_in = 0;         // cancels + mass cancels received
+  uint64_t cancels_overtaken = 0;  // cancels that jumped queued new orders
+  uint64_t queue_full_rejects = 0;
+  uint64_t max_queue_depth = 0;
+};
+
+/**
+ * Hand a book the ingress time of the request about to be applied. Books
+ * that stamp event envelopes (LevelBook) overload this; any other book,
+ * e.g. Liquibook's OrderBook, just doesn't get it.
+ */
+template <class Book> void set_ingress_time(Book &, uint64_t) {}
+
+/**
+ * ============================================================================
+ * CLASS: OrderGateway
+ * ============================================================================
+ * The front door of the engine: every client message passes through here
+ * before it reaches the order book.
+ *
+ * For each incoming order the gateway:
+ * 1. Checks the session is logged on
+ * 2. Throttles the session if it exceeds its order rate
+ * 3. Rejects retransmitted (duplicate) ClOrdIDs, and flags orders that
+ *    may be ones (SimpleOrder::possible_duplicate_)
+ * 4. Interns the ClOrdID into a dense internal ID (order->internal_id_)
+ * 5. Queues the order for the matching thread
+ *
+ * Cancels skip the throttle and go into the queue's priority lane, so they
+ * overtake new orders that are still waiting. process() drains the queue
+ * into the book.
+ *
+ * Rejections are reported through the same listener the book uses, so the
+ * client sees them exactly like a book reject, only with its own reason.
+ *
+ * The gateway is also the book's listener: set it with
+ * book.set_order_listener(&gateway). It passes every event on to the
+ * client listener, and keeps track of which orders are still live. An
+ * order is forgotten, and its internal ID released, as soon as the book
+ * reports it filled in full, canceled or rejected, so mass_cancel() only
+ * ever sees orders that are still in the book, and only the session's
+ * own (each session keeps its own list of live orders).
+ *
+ * @tparam Book  any book with Liquibook's add()/cancel()/replace() signatures
+ */
+template <class Book>
+class OrderGateway : public liquibook::book::OrderListener<SimpleOrder *> {
+public:
+  typedef liquibook::book::OrderListener<SimpleOrder *> Listener;
+  typedef liquibook::book::Quantity Quantity;
+
+  /// Reject reasons (distinct so clients can tell them apart)
+  static const char *reason_unknown_session() { return "Unknown session"; }
+  static const char *reason_duplicate() { return "Duplicate ClOrdID"; }
+  static const char *reason_throttled() {
+    return "Throttled: session order rate exceeded";
+  }
+  static const char *reason_queue_full() { return "Ingress queue full"; }
+  static const char *reason_wrong_session() {
+    return "Order belongs to another session";
+  }
+
+  /**
+   * @param book               book that queued messages are applied to;
+   *                           its order listener must be this gateway
+   * @param listener           receives gateway rejects and every book
+   *                           event the gateway passes on
+   * @param queue_capacity     max queued new orders/replaces
+   * @param priority_capacity  max queued cancels
+   */
+  OrderGateway(Book &book, Listener &listener, size_t queue_capacity = 65536,
+               size_t priority_capacity = 65536)
+      : book_(book), listener_(listener),
+        queue_(queue_capacity, priority_capacity) {
+    TscClock::init(); // not on the first order
+  }
+
+  /**
+   * Log a session on. Memory for duplicate detection is allocated here,
+   * once, and stays fixed for the life of the session.
+   */
+  void open_session(uint32_t session, const SessionLimits &limits =
+                                          SessionLimits()) {
+    sessions_.erase(session);
+    sessions_.insert(std::make_pair(session, Session(limits)));
+  }
+
+  /// Log a session off and free its duplicate-detection memory. Its live
+  /// orders stay in the book and are still tracked, so a mass_cancel()
+  /// after the session logs back on still finds them.
+  void close_session(uint32_t session) { sessions_.erase(session); }
+
+  /**
+   * Submit a new client order.
+   *
+   * @param session     session the order arrived on
+   * @param order       the order (order_id_ holds the client's ClOrdID)
+   * @param conditions  Liquibook order conditions (AON, IOC, ...)
+   * @return true if the order was queued for the book
+   */
+  bool submit(uint32_t session, SimpleOrder *order,
+              liquibook::book::OrderConditions conditions = 0) {
+    Session *s = find_session(session);
+    if (s == NULL) {
+      listener_.on_reject(order, reason_unknown_session());
+      return false;
+    }
+    ++s->metrics.orders_in;
+    ++totals_.orders_in;
+
+    // Throttle before the duplicate check, so a throttled ClOrdID can be
+    // sent again later. The same clock read is the ingress time.
+    const uint64_t now = now_ns();
+    if (!s->throttle.try_consume(now)) {
+      ++s->metrics.orders_throttled;
+      ++totals_.orders_throttled;
+      listener_.on_reject(order, reason_throttled());
+      return false;
+    }
+
+    const std::string &clordid = order->order_id_;
+    uint64_t key = ClOrdIdInterner::hash(clordid.data(), clordid.size(),
+                                         session);
+    DuplicateFilter::Result result = s->duplicates.check_and_insert(key);
+    if (result == DuplicateFilter::DUPLICATE) {
+      ++s->metrics.duplicates_rejected;
+      ++totals_.duplicates_rejected;
+      listener_.on_reject(order, reason_duplicate());
+      return false;
+    }
+    // A Bloom hit alone isn't proof: a new ClOrdID can hit too. Let the
+    // order through, flagged so the client or operations can check it.
+    order->possible_duplicate_ = result == DuplicateFilter::POSSIBLE_DUPLICATE;
+    if (order->possible_duplicate_) {
+      ++s->metrics.possible_duplicates;
+      ++totals_.possible_duplicates;
+    }
+
+    order->session_id_ = session;
+    order->internal_id_ = ids_.intern(session, clordid);
+    track(order);
+
+    Message msg;
+    msg.type = Message::NEW_ORDER;
+    msg.session = session;
+    msg.order = order;
+    msg.conditions = conditions;
+    msg.ingress_ns = now;
+    if (!enqueue(*s, msg)) {
+      untrack(order->internal_id_, order);
+      listener_.on_reject(order, reason_queue_full());
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Request a replace. Counts against the session's order rate like a new
+   * order, since it adds risk the same way.
+   *
+   * @return true if queued
+   */
+  bool replace(uint32_t session, SimpleOrder *order,
+               int64_t size_delta = liquibook::book::SIZE_UNCHANGED,
+               liquibook::book::Price new_price =
+                   liquibook::book::PRICE_UNCHANGED) {
+    Session *s = find_session(session);
+    if (s == NULL) {
+      listener_.on_replace_reject(order, reason_unknown_session());
+      return false;
+    }
+    if (order->session_id_ != session) {
+      listener_.on_replace_reject(order, reason_wrong_session());
+      return false;
+    }
+    ++s->metrics.orders_in;
+    ++totals_.orders_in;
+    const uint64_t now = now_ns();
+    if (!s->throttle.try_consume(now)) {
+      ++s->metrics.orders_throttled;
+      ++totals_.orders_throttled;
+      listener_.on_replace_reject(order, reason_throttled());
+      return false;
+    }
+
+    Message msg;
+    msg.type = Message::REPLACE;
+    msg.session = session;
+    msg.order = order;
+    msg.size_delta = size_delta;
+    msg.new_price = new_price;
+    msg.ingress_ns = now;
+    if (!enqueue(*s, msg)) {
+      listener_.on_replace_reject(order, reason_queue_full());
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Request a cancel. Never throttled, and queued in the priority lane.
+   *
+   * @return true if queued
+   */
+  bool cancel(uint32_t session, SimpleOrder *order) {
+    Session *s = find_session(session);
+    if (s == NULL) {
+      listener_.on_cancel_reject(order, reason_unknown_session());
+      return false;
+    }
+    if (order->session_id_ != session) {
+      listener_.on_cancel_reject(order, reason_wrong_session());
+      return false;
+    }
+    Message msg;
+    msg.type = Message::CANCEL;
+    msg.session = session;
+    msg.order = order;
+    msg.ingress_ns = now_ns();
+    if (!enqueue_priority(*s, msg)) {
+      listener_.on_cancel_reject(order, reason_queue_full());
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Request cancellation of every live order on a session (e.g. on
+   * disconnect). Queued in the priority lane. Costs O(the session's live
+   * orders), however many other sessions have.
+   *
+   * @return true if queued
+   */
+  bool mass_cancel(uint32_t session) {
+    Session *s = find_session(session);
+    if (s == NULL) {
+      return false;
+    }
+    Message msg;
+    msg.type = Message::MASS_CANCEL;
+    msg.session = session;
+    msg.ingress_ns = now_ns();
+    return enqueue_priority(*s, msg);
+  }
+
+  /**
+   * Apply queued messages to the book (called on the matching thread).
+   * Cancels are always applied before any queued new order.
+   *
+   * @param max_messages  stop after this many messages
+   * @return number of messages applied
+   */
+  size_t process(size_t max_messages = ~size_t(0)) {
+    size_t done = 0;
+    Message msg;
+    while (done < max_messages && queue_.pop(msg)) {
+      apply(msg);
+      ++done;
+    }
+    return done;
+  }
+
+  // Book events: passed on to the client listener, then used to forget
+  // orders that are done. The order isn't read after the client has seen
+  // the event, since the client may delete it then.
+
+  void on_accept(SimpleOrder *const &order) override {
+    listener_.on_accept(order);
+  }
+
+  void on_reject(SimpleOrder *const &order, const char *reason) override {
+    const uint64_t id = order->internal_id_;
+    SimpleOrder *const done = order;
+    listener_.on_reject(order, reason);
+    untrack(id, done);
+  }
+
+  void on_fill(SimpleOrder *const &order, SimpleOrder *const &matched,
+               Quantity fill_qty, liquibook::book::Cost fill_cost) override {
+    const uint64_t order_id = order->internal_id_;
+    const uint64_t matched_id = matched->internal_id_;
+    SimpleOrder *const taker = order;
+    SimpleOrder *const maker = matched;
+    listener_.on_fill(order, matched, fill_qty, fill_cost);
+    filled(order_id, taker, fill_qty);
+    filled(matched_id, maker, fill_qty);
+  }
+
+  void on_cancel(SimpleOrder *const &order) override {
+    const uint64_t id = order->internal_id_;
+    SimpleOrder *const done = order;
+    listener_.on_cancel(order);
+    untrack(id, done);
+  }
+
+  void on_cancel_reject(SimpleOrder *const &order,
+                        const char *reason) override {
+    listener_.on_cancel_reject(order, reason);
+  }
+
+  void on_replace(SimpleOrder *const &order, const int64_t &size_delta,
+                  liquibook::book::Price new_price) override {
+    LiveOrder *live = find_live(order->internal_id_, order);
+    if (live != NULL) {
+      live->open = Quantity(int64_t(live->open) + size_delta);
+    }
+    listener_.on_replace(order, size_delta, new_price);
+  }
+
+  void on_replace_reject(SimpleOrder *const &order,
+                         const char *reason) override {
+    listener_.on_replace_reject(order, reason);
+  }
+
+  /// @return the ClOrdID interner (maps internal IDs back to client IDs)
+  const ClOrdIdInterner &ids() const { return ids_; }
+
+  /// @return counters summed over all sessions
+  const GatewayMetrics &metrics() const { return totals_; }
+
+  /// @return counters for one session, or NULL if not logged on
+  const GatewayMetrics *session_metrics(uint32_t session) const {
+    typename Sessions::const_iterator it = sessions_.find(session);
+    return it == sessions_.end() ? NULL : &it->second.metrics;
+  }
+
+  /// @return messages waiting for process()
+  size_t queue_depth() const { return queue_.size(); }
+
+private:
+  struct Message {
+    enum Type { NEW_ORDER, REPLACE, CANCEL, MASS_CANCEL };
+    Type type = NEW_ORDER;
+    uint32_t session = 0;
+    SimpleOrder *order = NULL;
+    liquibook::book::OrderConditions conditions = 0;
+    int64_t size_delta = 0;
+    liquibook::book::Price new_price = 0;
+    uint64_t ingress_ns = 0; // when submit()/replace()/cancel() was called
+  };
+
+  struct Session {
+    explicit Session(const SessionLimits &limits)
+        : throttle(limits.orders_per_second, limits.burst),
+          duplicates(limits.window_size, limits.expected_orders,
+                     limits.max_false_positive) {}
+
+    TokenBucket throttle;
+    DuplicateFilter duplicates;
+    GatewayMetrics metrics;
+  };
+
+  typedef std::unordered_map<uint32_t, Session> Sessions;
+
+  /// An order the book may still hold, indexed by internal ID
+  struct LiveOrder {
+    SimpleOrder *order = NULL; // NULL = slot free
+    Quantity open = 0;         // not yet filled
+    uint32_t session = 0;
+    size_t session_slot = 0;   // index in session_orders_[session]
+  };
+
+  /// Internal IDs of each session's live orders, in no particular order
+  typedef std::unordered_map<uint32_t, std::vector<uint64_t> > SessionOrders;
+
+  void track(SimpleOrder *order) {
+    const uint64_t id = order->internal_id_;
+    if (id >= live_orders_.size()) {
+      live_orders_.resize(id + 1);
+    }
+    std::vector<uint64_t> &ids = session_orders_[order->session_id_];
+    LiveOrder &live = live_orders_[id];
+    live.order = order;
+    live.open = order->order_qty();
+    live.session = order->session_id_;
+    live.session_slot = ids.size();
+    ids.push_back(id);
+  }
+
+  /// @return the live entry for `id` if it still belongs to `order`
+  LiveOrder *find_live(uint64_t id, const SimpleOrder *order) {
+    if (id >= live_orders_.size() || live_orders_[id].order != order) {
+      return NULL;
+    }
+    return &live_orders_[id];
+  }
+
+  /**
+   * Forget a filled, canceled or rejected order and free its internal
+   * ID. The ClOrdID stays in the duplicate filter, so it still cannot be
+   * reused on the session. Doesn't read `order`.
+   */
+  void untrack(uint64_t id, const SimpleOrder *order) {
+    LiveOrder *live = find_live(id, order);
+    if (live == NULL) {
+      return;
+    }
+    // Swap the last of the session's orders into this one's place
+    std::vector<uint64_t> &ids = session_orders_[live->session];
+    const size_t slot = live->session_slot;
+    ids[slot] = ids.back();
+    live_orders_[ids[slot]].session_slot = slot;
+    ids.pop_back();
+    *live = LiveOrder();
+    ids_.release(id);
+  }
+
+  void filled(uint64_t id, const SimpleOrder *order, Quantity qty) {
+    LiveOrder *live = find_live(id, order);
+    if (live == NULL) {
+      return;
+    }
+    live->open = live->open > qty ? live->open - qty : 0;
+    if (live->open == 0) {
+      untrack(id, order);
+    }
+  }
+
+  static uint64_t now_ns() { return TscClock::now(); }
+
+  Session *find_session(uint32_t session) {
+    typename Sessions::iterator it = sessions_.find(session);
+    return it == sessions_.end() ? NULL : &it->second;
+  }
+
+  bool enqueue(Session &s, const Message &msg) {
+    if (!queue_.push(msg)) {
+      ++s.metrics.queue_full_rejects;
+      ++totals_.queue_full_rejects;
+      return false;
+    }
+    note_depth();
+    return true;
+  }
+
+  bool enqueue_priority(Session &s, const Message &msg) {
+    ++s.metrics.cancels_in;
+    ++totals_.cancels_in;
+    if (!queue_.push_priority(msg)) {
+      ++s.metrics.queue_full_rejects;
+      ++totals_.queue_full_rejects;
+      return false;
+    }
+    // Everything in the normal lane is now behind this cancel
+    if (queue_.size() > queue_.priority_size()) {
+      ++s.metrics.cancels_overtaken;
+      ++totals_.cancels_overtaken;
+    }
+    note_depth();
+    return true;
+  }
+
+  void note_depth() {
+    if (queue_.size() > totals_.max_queue_depth) {
+      totals_.max_queue_depth = queue_.size();
+    }
+  }
+
+  void apply(const Message &msg) {
+    set_ingress_time(book_, msg.ingress_ns);
+    switch (msg.type) {
+    case Message::NEW_ORDER:
+      book_.add(msg.order, msg.conditions);
+      break;
+    case Message::REPLACE:
+      book_.replace(msg.order, msg.size_delta, msg.new_price);
+      break;
+    case Message::CANCEL:
+      book_.cancel(msg.order);
+      break;
+    case Message::MASS_CANCEL: {
+      typename SessionOrders::iterator it = session_orders_.find(msg.session);
+      if (it == session_orders_.end()) {
+        break;
+      }
+      // Backwards: a book that reports the cancel at once removes the
+      // order from this list, moving the last one (already done) here
+      std::vector<uint64_t> &ids = it->second;
+      for (size_t i = ids.size(); i-- > 0;) {
+        if (i < ids.size()) {
+          set_ingress_time(book_, msg.ingress_ns);
+          book_.cancel(live_orders_[ids[i]].order);
+        }
+      }
+      break;
+    }
+    }
+  }
+
+  Book &book_;
+  Listener &listener_;
+  IngressQueue<Message> queue_;
+  Sessions sessions_;
+  ClOrdIdInterner ids_;
+  std::vector<LiveOrder> live_orders_; // indexed by internal ID
+  SessionOrders session_orders_;
+  GatewayMetrics totals_;
+};
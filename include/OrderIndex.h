@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * ============================================================================
+ * CLASS: OrderIndex
+ * ============================================================================
+ * Maps a resting order's handle to where it sits in the book.
+ *
+ * A flat open-addressing table (linear probing, backward-shift deletion,
+ * the same scheme as ClOrdIdInterner) instead of std::unordered_map:
+ * - no allocation per order, so adding and removing orders never calls
+ *   malloc once the table has grown;
+ * - clear() is one pass over two flat arrays, not one free() per order,
+ *   which is what makes the end-of-session purge cheap.
+ *
+ * The default-constructed key (NULL for raw pointers) marks an empty slot
+ * and can't be stored.
+ *
+ * @tparam Key    order handle (e.g. SimpleOrder *)
+ * @tparam Value  what is stored per order
+ */
+template <class Key, class Value> class OrderIndex {
+public:
+  explicit OrderIndex(size_t initial_capacity = 64) : size_(0) {
+    size_t capacity = 16;
+    while (capacity < initial_capacity * 2) {
+      capacity <<= 1;
+    }
+    allocate(capacity);
+  }
+
+  /// @return the value stored for `key`, or NULL
+  Value *find(const Key &key) {
+    size_t pos = home(key);
+    while (!(keys_[pos] == Key())) {
+      if (keys_[pos] == key) {
+        return &values_[pos];
+      }
+      pos = (pos + 1) & mask_;
+    }
+    return NULL;
+  }
+
+  const Value *find(const Key &key) const {
+    return const_cast<OrderIndex *>(this)->find(key);
+  }
+
+  /// Start loading `key`'s slot into cache ahead of a find() or erase().
+  /// The slot is at a random address, so walking many orders otherwise
+  /// waits on one cache miss per order.
+  void prefetch(const Key &key) const {
+    size_t pos = home(key);
+    __builtin_prefetch(&keys_[pos], 1);
+    __builtin_prefetch(&values_[pos], 1);
+  }
+
+  /// @return the value for `key`, inserting a default one if missing
+  Value &operator[](const Key &key) {
+    Value *found = find(key);
+    if (found != NULL) {
+      return *found;
+    }
+    if ((size_ + 1) * 2 > keys_.size()) {
+      grow();
+    }
+    size_t pos = home(key);
+    while (!(keys_[pos] == Key())) {
+      pos = (pos + 1) & mask_;
+    }
+    keys_[pos] = key;
+    values_[pos] = Value();
+    ++size_;
+    return values_[pos];
+  }
+
+  /// Remove `key` if present
+  void erase(const Key &key) {
+    size_t hole = home(key);
+    while (!(keys_[hole] == key)) {
+      if (keys_[hole] == Key()) {
+        return;
+      }
+      hole = (hole + 1) & mask_;
+    }
+    size_t next = (hole + 1) & mask_;
+    while (!(keys_[next] == Key())) {
+      size_t want = home(keys_[next]);
+      if (((next - want) & mask_) >= ((next - hole) & mask_)) {
+        keys_[hole] = keys_[next];
+        values_[hole] = values_[next];
+        hole = next;
+      }
+      next = (next + 1) & mask_;
+    }
+    keys_[hole] = Key();
+    --size_;
+  }
+
+  /// Forget every order; keeps the capacity
+  void clear() {
+    if (size_ != 0) {
+      std::fill(keys_.begin(), keys_.end(), Key());
+      size_ = 0;
+    }
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+private:
+  size_t home(const Key &key) const {
+    // Fibonacci hashing: the high bits of the product are well mixed even
+    // for aligned pointers, whose low bits are always zero
+    uint64_t h = uint64_t(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ULL;
+    return size_t(h >> shift_);
+  }
+
+  void allocate(size_t capacity) {
+    keys_.assign(capacity, Key());
+    values_.assign(capacity, Value());
+    mask_ = capacity - 1;
+    shift_ = 64;
+    while (capacity > 1) {
+      capacity >>= 1;
+      --shift_;
+    }
+  }
+
+  void grow() {
+    std::vector<Key> keys;
+    std::vector<Value> values;
+    keys.swap(keys_);
+    values.swap(values_);
+    allocate(keys.size() * 2);
+    size_ = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (!(keys[i] == Key())) {
+        (*this)[keys[i]] = values[i];
+      }
+    }
+  }
+
+  std::vector<Key> keys_; // Key() = empty slot
+  std::vector<Value> values_;
+  size_t mask_;
+  unsigned shift_; // 64 - log2(capacity)
+  size_t size_;
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * ============================================================================
+ * STRUCT: HotOrder
+ * ============================================================================
+ * The part of an order the matcher reads: side, price, quantity and
+ * conditions, in 20 bytes. Three fit in a cache line, where a SimpleOrder
+ * with its two strings takes more than one line by itself.
+ *
+ * It has the same accessors as SimpleOrder, so a LevelBook<HotOrder *>
+ * works unchanged. The cold part (IDs, symbol, session) is in the
+ * OrderStore that owns it, and is read through the store: where code on a
+ * SimpleOrder reads order->session_id_, code on a HotOrder reads
+ * store.session_id(order).
+ */
+struct HotOrder {
+  bool is_buy() const { return (flags_ & BUY) != 0; }
+  uint32_t order_qty() const { return quantity_; }
+  int32_t price() const { return price_; }
+  int32_t stop_price() const { return stop_price_; }
+  bool all_or_none() const { return (flags_ & ALL_OR_NONE) != 0; }
+  bool immediate_or_cancel() const {
+    return (flags_ & IMMEDIATE_OR_CANCEL) != 0;
+  }
+  bool hidden() const { return (flags_ & HIDDEN) != 0; }
+  bool post_only() const { return (flags_ & POST_ONLY) != 0; }
+  uint32_t min_qty() const { return min_qty_; }
+  bool good_till_cancel() const { return (flags_ & GOOD_TILL_CANCEL) != 0; }
+
+  /// Apply new terms after an accepted replace (see SimpleOrder)
+  void accept_replace(uint32_t new_qty, int32_t new_price) {
+    quantity_ = new_qty;
+    price_ = new_price;
+  }
+
+  enum Flag {
+    BUY = 1,
+    ALL_OR_NONE = 2,
+    IMMEDIATE_OR_CANCEL = 4,
+    HIDDEN = 8,
+    POST_ONLY = 16,
+    GOOD_TILL_CANCEL = 32
+  };
+
+  int32_t price_;
+  uint32_t quantity_;
+  int32_t stop_price_;
+  uint32_t min_qty_;
+  uint8_t flags_; // Flag bits
+};
+
+/// The part of an order the matcher never reads
+struct ColdOrder {
+  std::string order_id;
+  std::string symbol;
+  /// Dense engine-side ID (see ClOrdIdInterner); all ones until assigned
+  uint64_t internal_id;
+  /// Gateway session the order arrived on
+  uint32_t session_id;
+};
+
+/**
+ * ============================================================================
+ * CLASS: OrderStore
+ * ============================================================================
+ * Owns orders split into hot and cold halves: a compact array of
+ * HotOrder and, at the same index, a side table of ColdOrder.
+ *
+ * A book holds HotOrder pointers, so everything it touches while matching
+ * is packed into few cache lines; the strings are only read by code that
+ * asks for them (listeners, drop copies) through cold().
+ *
+ * Both arrays are allocated once, at their full capacity, so pointers
+ * stay valid and adding an order never allocates (a reused slot keeps
+ * its strings' buffers, too). Freed slots are reused last in, first out,
+ * so recently used, cache-warm slots are handed out first.
+ */
+class OrderStore {
+public:
+  /// @param capacity  most orders alive at once
+  explicit OrderStore(size_t capacity) : hot_(capacity), cold_(capacity) {
+    free_.reserve(capacity);
+    for (size_t slot = capacity; slot != 0; --slot) {
+      free_.push_back(uint32_t(slot - 1));
+    }
+  }
+
+  /**
+   * Create an order; parameters as for SimpleOrder.
+   *
+   * @return the order, or NULL if the store is full
+   */
+  HotOrder *add(bool is_buy, uint32_t qty, int32_t price,
+                const std::string &id, int32_t stop_price = 0,
+                bool all_or_none = false, bool immediate_or_cancel = false,
+                bool hidden = false, bool post_only = false,
+                uint32_t min_qty = 0, bool good_till_cancel = false,
+                const std::string &symbol = "AAPL") {
+    if (free_.empty()) {
+      return NULL;
+    }
+    uint32_t slot = free_.back();
+    free_.pop_back();
+
+    HotOrder &hot = hot_[slot];
+    hot.price_ = price;
+    hot.quantity_ = qty;
+    hot.stop_price_ = stop_price;
+    hot.min_qty_ = min_qty;
+    hot.flags_ = uint8_t(
+        (is_buy ? HotOrder::BUY : 0) |
+        (all_or_none ? HotOrder::ALL_OR_NONE : 0) |
+        (immediate_or_cancel ? HotOrder::IMMEDIATE_OR_CANCEL : 0) |
+        (hidden ? HotOrder::HIDDEN : 0) | (post_only ? HotOrder::POST_ONLY : 0) |
+        (good_till_cancel ? HotOrder::GOOD_TILL_CANCEL : 0));
+
+    ColdOrder &cold = cold_[slot];
+    cold.order_id = id;
+    cold.symbol = symbol;
+    cold.internal_id = ~uint64_t(0);
+    cold.session_id = 0;
+    return &hot;
+  }
+
+  /// Free an order's slot (it must no longer be in any book)
+  void release(HotOrder *order) { free_.push_back(uint32_t(slot(order))); }
+
+  /// @return the order's index in both arrays
+  size_t slot(const HotOrder *order) const { return size_t(order - &hot_[0]); }
+
+  ColdOrder &cold(const HotOrder *order) { return cold_[slot(order)]; }
+  const ColdOrder &cold(const HotOrder *order) const {
+    return cold_[slot(order)];
+  }
+
+  // Cold fields by order, the same ones SimpleOrder has as members
+
+  /// @return the client's order ID
+  const std::string &order_id(const HotOrder *order) const {
+    return cold(order).order_id;
+  }
+
+  const std::string &symbol(const HotOrder *order) const {
+    return cold(order).symbol;
+  }
+
+  /// @return the dense engine-side ID (all ones until set_ids())
+  uint64_t internal_id(const HotOrder *order) const {
+    return cold(order).internal_id;
+  }
+
+  /// @return the gateway session the order arrived on
+  uint32_t session_id(const HotOrder *order) const {
+    return cold(order).session_id;
+  }
+
+  /// Record where the order came from (what the gateway does on submit)
+  void set_ids(const HotOrder *order, uint32_t session_id,
+               uint64_t internal_id) {
+    ColdOrder &c = cold(order);
+    c.session_id = session_id;
+    c.internal_id = internal_id;
+  }
+
+  size_t size() const { return hot_.size() - free_.size(); }
+  size_t capacity() const { return hot_.size(); }
+
+private:
+  std::vector<HotOrder> hot_;
+  std::vector<ColdOrder> cold_;
+  std::vector<uint32_t> free_; // free slots, next one to use at the back
+};
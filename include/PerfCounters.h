@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * ============================================================================
+ * CLASS: PerfCounters
+ * ============================================================================
+ * Reads the CPU's hardware event counters around a piece of code, for
+ * benchmarks that need to say why something is fast or slow, not just
+ * how fast: cache lines missed, branches mispredicted, instructions per
+ * cycle.
+ *
+ *   PerfCounters perf;
+ *   perf.start();
+ *   sweep();
+ *   perf.stop();
+ *   perf.get(PerfCounters::L1D_MISSES) / orders   // misses per order
+ *
+ * Linux only, through perf_event_open(), counting this thread in user
+ * space. Each event is opened on its own, so an event the CPU or the
+ * kernel doesn't offer (common in VMs and containers, or with
+ * kernel.perf_event_paranoid > 2) just reads as unavailable while the
+ * others still work.
+ */
+class PerfCounters {
+public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,  // L1 data cache read misses
+    LLC_MISSES,  // last-level cache misses (went to memory)
+    BRANCH_MISSES,
+    EVENT_COUNT
+  };
+
+  PerfCounters() {
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+      fds_[e] = open(Event(e));
+      values_[e] = 0;
+    }
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+      if (fds_[e] >= 0) {
+        close(fds_[e]);
+      }
+    }
+#endif
+  }
+
+  /// @return true if `event` can be counted here
+  bool available(Event event) const { return fds_[event] >= 0; }
+
+  /// @return true if any event can be counted
+  bool any_available() const {
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+      if (fds_[e] >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Zero and start every available counter
+  void start() {
+#ifdef __linux__
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+      if (fds_[e] >= 0) {
+        ioctl(fds_[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds_[e], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /// Stop the counters and read them
+  void stop() {
+#ifdef __linux__
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+      if (fds_[e] >= 0) {
+        ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        values_[e] = read(fds_[e], &value, sizeof(value)) == sizeof(value)
+                         ? value
+                         : 0;
+      }
+    }
+#endif
+  }
+
+  /// @return the count between the last start() and stop()
+  uint64_t get(Event event) const { return values_[event]; }
+
+  static const char *name(Event event) {
+    static const char *const names[EVENT_COUNT] = {
+        "cycles", "instructions", "L1D misses", "LLC misses",
+        "branch misses"};
+    return names[event];
+  }
+
+private:
+  PerfCounters(const PerfCounters &);
+  PerfCounters &operator=(const PerfCounters &);
+
+  static int open(Event event) {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (event) {
+    case CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case L1D_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case LLC_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case BRANCH_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    default:
+      return -1;
+    }
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    (void)event;
+    return -1;
+#endif
+  }
+
+  int fds_[EVENT_COUNT];
+  uint64_t values_[EVENT_COUNT];
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <book/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * ============================================================================
+ * STRUCT: OrderQueue
+ * ============================================================================
+ * Resting orders at one price, in time priority.
+ *
+ * Orders are kept in two parallel arrays ("structure of arrays"): the order
+ * pointers, and their open quantities. A queue slot whose quantity is 0 has
+ * been filled or canceled and is skipped. Keeping quantities in their own
+ * contiguous array means allocation loops (like pro-rata) run over plain
+ * integers the compiler can vectorize.
+ *
+ * A Fenwick tree (binary indexed tree) over open_qty answers "how much
+ * quantity is ahead of slot i?" in O(log n) instead of summing the queue.
+ * Entry k of the tree holds the sum of a block of slots ending at k whose
+ * length is the lowest set bit of k, so a prefix sum adds O(log n)
+ * blocks, and a fill or cancel updates O(log n) of them. A fill that
+ * empties the head slot skips the update: slots before `head` may keep
+ * stale values in the tree, which cancel out because qty_ahead() counts
+ * from `head`. So plain FIFO consumption costs nothing extra. Code that
+ * edits orders/open_qty directly (compaction) must call reindex() after.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr> struct OrderQueue {
+  typedef liquibook::book::Quantity Quantity;
+
+  OrderQueue() : head(0), total_qty(0), live(0) {}
+
+  /// Append an order at the back of the queue
+  /// @return its queue slot
+  size_t push_back(const OrderPtr &order, Quantity qty) {
+    orders.push_back(order);
+    open_qty.push_back(qty);
+    total_qty += qty;
+    ++live;
+    if (tree.empty()) {
+      tree.push_back(0); // entry 0 is unused
+    }
+    // New tree entry k covers slots (k - lowbit(k), k]
+    size_t k = orders.size();
+    tree.push_back(qty + prefix(k - 1) - prefix(k - (k & (0 - k))));
+    return orders.size() - 1;
+  }
+
+  /// Take quantity out of a slot (fill or cancel)
+  /// @param update_tree  false when the caller will reindex() anyway
+  /// @return true if the slot is now empty
+  bool reduce(size_t slot, Quantity qty, bool update_tree = true) {
+    open_qty[slot] -= qty;
+    total_qty -= qty;
+    if (update_tree && (slot != head || open_qty[slot] != 0)) {
+      for (size_t k = slot + 1; k < tree.size(); k += k & (0 - k)) {
+        tree[k] -= qty;
+      }
+    }
+    if (open_qty[slot] != 0) {
+      return false;
+    }
+    --live;
+    while (head < open_qty.size() && open_qty[head] == 0) {
+      ++head;
+    }
+    return true;
+  }
+
+  bool empty() const { return live == 0; }
+
+  /// Empty the queue but keep its arrays' capacity
+  void clear() {
+    orders.clear();
+    open_qty.clear();
+    tree.clear();
+    head = 0;
+    total_qty = 0;
+    live = 0;
+  }
+
+  /// @return open quantity queued ahead of `slot` (O(log n))
+  Quantity qty_ahead(size_t slot) const { return prefix(slot) - prefix(head); }
+
+  /// Rebuild the tree after orders/open_qty were edited directly (O(n))
+  void reindex() {
+    tree.assign(open_qty.size() + 1, 0);
+    for (size_t k = 1; k < tree.size(); ++k) {
+      tree[k] += open_qty[k - 1];
+      size_t parent = k + (k & (0 - k));
+      if (parent < tree.size()) {
+        tree[parent] += tree[k];
+      }
+    }
+  }
+
+  std::vector<OrderPtr> orders;   // queue slot -> order, time priority
+  std::vector<Quantity> open_qty; // queue slot -> open quantity, 0 = gone
+  size_t head;                    // first slot that may still be live
+  Quantity total_qty;             // sum of open_qty
+  size_t live;                    // slots with open_qty > 0
+  std::vector<Quantity> tree;     // Fenwick tree over open_qty, 1-based
+                                  // (empty until the first push_back)
+
+private:
+  /// Sum of open_qty over slots [0, count)
+  Quantity prefix(size_t count) const {
+    Quantity sum = 0;
+    for (size_t k = count; k != 0; k -= k & (0 - k)) {
+      sum += tree[k];
+    }
+    return sum;
+  }
+};
+
+/**
+ * ============================================================================
+ * STRUCT: PriceLevel
+ * ============================================================================
+ * All resting orders at one price on one side of a LevelBook.
+ *
+ * Displayed and hidden orders are kept in two separate queues. Depth only
+ * ever reads the lit queue's total, so hidden orders never need to be
+ * filtered out one by one. When matching, the lit queue trades first and
+ * hidden orders at the same price trade after it.
+ *
+ * @tparam OrderPtr  pointer-like order handle (e.g. SimpleOrder *)
+ */
+template <class OrderPtr> struct PriceLevel {
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef OrderQueue<OrderPtr> Queue;
+
+  explicit PriceLevel(Price p = 0) : price(p) {}
+
+  Queue &queue(bool is_hidden) { return is_hidden ? hidden : lit; }
+
+  /// @return quantity shown in market data
+  Quantity displayed_qty() const { return lit.total_qty; }
+  /// @return all quantity an aggressor can trade with, hidden included
+  Quantity total_qty() const { return lit.total_qty + hidden.total_qty; }
+
+  bool empty() const { return lit.empty() && hidden.empty(); }
+
+  Price price;
+  Queue lit;    // displayed orders
+  Queue hidden; // non-displayed orders, matched after lit
+};
+
+/**
+ * Split `qty` across a queue in proportion to each order's size.
+ *
+ * Integer only, and deterministic:
+ * 1. Each slot gets floor(open * qty / total), computed as a multiply by a
+ *    32.32 fixed-point ratio so the loop has no division and vectorizes.
+ * 2. The few lots lost to rounding go one at a time to orders in time
+ *    priority that still have room.
+ *
+ * Quantities must fit in 32 bits (SimpleOrder uses uint32_t).
+ *
+ * @param open_qty  open quantity per slot (0 = empty slot)
+ * @param alloc     output, same length as open_qty
+ * @param begin     first slot to consider
+ * @param end       one past the last slot
+ * @param total     sum of open_qty over [begin, end)
+ * @param qty       quantity to allocate, must be < total
+ */
+inline void pro_rata_allocate(const liquibook::book::Quantity *open_qty,
+                              liquibook::book::Quantity *alloc, size_t begin,
+                              size_t end, liquibook::book::Quantity total,
+                              liquibook::book::Quantity qty) {
+  const uint64_t ratio = (uint64_t(qty) << 32) / total; // qty / total, 32.32
+  uint64_t allocated = 0;
+  for (size_t i = begin; i < end; ++i) {
+    alloc[i] = (open_qty[i] * ratio) >> 32;
+    allocated += alloc[i];
+  }
+
+  uint64_t leftover = qty - allocated;
+  while (leftover != 0) {
+    for (size_t i = begin; i < end && leftover != 0; ++i) {
+      if (open_qty[i] > alloc[i]) {
+        ++alloc[i];
+        --leftover;
+      }
+    }
+  }
+}
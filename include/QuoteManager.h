@@ -0,0 +1,369 @@
+#pragma once
+#include <BookCallbacks.h>
+#include <SimpleOrder.h>
+#include <book/order_book.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * One line of a (mass) quote: a maker's bid and ask for one symbol.
+ * A side with zero quantity pulls that side of the quote.
+ */
+struct QuoteEntry {
+  std::string symbol;
+  liquibook::book::Price bid_price = 0;
+  liquibook::book::Quantity bid_qty = 0;
+  liquibook::book::Price ask_price = 0;
+  liquibook::book::Quantity ask_qty = 0;
+};
+
+/**
+ * ============================================================================
+ * CLASS: QuoteManager
+ * ============================================================================
+ * Two-sided quotes for market makers.
+ *
+ * A market maker always shows a bid AND an ask. Updating them as two
+ * separate orders means two trips through the gateway and the book, and a
+ * window where only one side has moved. Here one quote message updates both
+ * sides, and a mass quote updates hundreds of symbols at once.
+ *
+ * Each (session, symbol) pair owns a quote slot holding a bid order and an
+ * ask order. The slot is created once and reused: a new quote replaces the
+ * resting orders in place instead of cancel-and-new, so the maker keeps the
+ * same order objects all day.
+ *
+ * Book callbacks are flushed once per message, after every entry in it has
+ * been applied, so listeners never see a half-updated quote.
+ *
+ * The manager sits between the books and your listener: it tracks fills,
+ * cancels and replaces of quote orders, then forwards every callback
+ * unchanged. A quote side takes its new terms only when the book confirms
+ * the replace (on_replace); after a replace reject it keeps the old ones.
+ * Orders the manager doesn't own are left to your listener to update.
+ *
+ * The manager is an EnvelopeListener, so books that stamp events
+ * (LevelBook) keep stamping them once it takes over as their listener.
+ * Give it an EnvelopeListener as downstream and each forwarded event
+ * carries its envelope on.
+ *
+ * @tparam Book  a Liquibook-compatible book of SimpleOrder *
+ */
+template <class Book>
+class QuoteManager : public EnvelopeListener<SimpleOrder *> {
+public:
+  typedef liquibook::book::OrderListener<SimpleOrder *> Listener;
+  typedef EnvelopeListener<SimpleOrder *> TypedEnvelopeListener;
+
+  /// @param downstream  receives every callback after the manager sees it
+  explicit QuoteManager(Listener &downstream)
+      : downstream_(downstream), envelopes_(NULL) {}
+
+  /// Same, and `downstream` also gets each event's envelope
+  explicit QuoteManager(TypedEnvelopeListener &downstream)
+      : downstream_(downstream), envelopes_(&downstream) {}
+
+  /**
+   * Register a book. Its order listener is set to this manager, which
+   * passes every event on to downstream (install your gateway or other
+   * listener there, not on the book).
+   */
+  void add_book(Book &book) {
+    book_index_[book.symbol()] = books_.size();
+    books_.push_back(BookEntry(book));
+    book.set_order_listener(this);
+  }
+
+  /**
+   * Register a run of books that are quoted together, e.g. every series
+   * of an option chain (BookManager::Chain::series).
+   *
+   * @return handle of the first book, for mass_quote_series()
+   */
+  size_t add_books(Book *books, size_t count) {
+    size_t first = books_.size();
+    for (size_t i = 0; i < count; ++i) {
+      add_book(books[i]);
+    }
+    return first;
+  }
+
+  /**
+   * Update both sides of one quote.
+   * @return false if the entry was rejected
+   */
+  bool quote(uint32_t session, const QuoteEntry &entry) {
+    return mass_quote(session, &entry, 1) == 0;
+  }
+
+  /**
+   * Update many quotes in one message.
+   *
+   * Each entry is checked before either of its sides is touched: a crossed
+   * quote (bid >= ask) or an unknown symbol is skipped as a whole. Each
+   * symbol should appear at most once per message.
+   *
+   * @return number of rejected entries
+   */
+  size_t mass_quote(uint32_t session, const QuoteEntry *entries,
+                    size_t count) {
+    size_t rejected = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (!apply(session, entries[i])) {
+        ++rejected;
+      }
+    }
+    flush();
+    return rejected;
+  }
+
+  size_t mass_quote(uint32_t session, const std::vector<QuoteEntry> &entries) {
+    return entries.empty() ? 0
+                           : mass_quote(session, &entries[0], entries.size());
+  }
+
+  /**
+   * Mass quote a run of books registered with add_books(): entries[i]
+   * quotes book first + i, so no symbol is looked up (entry.symbol is
+   * ignored). This is how a maker requotes a whole option chain when the
+   * underlying moves.
+   *
+   * @param first  handle returned by add_books()
+   * @return number of rejected entries
+   */
+  size_t mass_quote_series(uint32_t session, size_t first,
+                           const QuoteEntry *entries, size_t count) {
+    size_t rejected = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (first + i >= books_.size() ||
+          !apply_at(session, first + i, entries[i])) {
+        ++rejected;
+      }
+    }
+    flush();
+    return rejected;
+  }
+
+  /**
+   * Pull every quote a session has (e.g. on disconnect), one flush.
+   */
+  void cancel_quotes(uint32_t session) {
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      QuoteSlot &slot = slots_[i];
+      if (slot.session == session) {
+        pull(slot.book, slot.bid);
+        pull(slot.book, slot.ask);
+      }
+    }
+    flush();
+  }
+
+  // OrderListener: track quote state, then forward
+
+  void on_accept(SimpleOrder *const &order) override {
+    pass_envelope();
+    downstream_.on_accept(order);
+  }
+
+  void on_reject(SimpleOrder *const &order, const char *reason) override {
+    QuoteSide *side = find_side(order);
+    if (side != NULL) {
+      side->open_qty = 0;
+    }
+    pass_envelope();
+    downstream_.on_reject(order, reason);
+  }
+
+  void on_fill(SimpleOrder *const &order, SimpleOrder *const &matched_order,
+               liquibook::book::Quantity fill_qty,
+               liquibook::book::Price fill_price) override {
+    note_fill(order, fill_qty);
+    note_fill(matched_order, fill_qty);
+    pass_envelope();
+    downstream_.on_fill(order, matched_order, fill_qty, fill_price);
+  }
+
+  void on_cancel(SimpleOrder *const &order) override {
+    QuoteSide *side = find_side(order);
+    if (side != NULL) {
+      side->open_qty = 0;
+    }
+    pass_envelope();
+    downstream_.on_cancel(order);
+  }
+
+  void on_cancel_reject(SimpleOrder *const &order,
+                        const char *reason) override {
+    pass_envelope();
+    downstream_.on_cancel_reject(order, reason);
+  }
+
+  void on_replace(SimpleOrder *const &order, const int64_t &size_delta,
+                  liquibook::book::Price new_price) override {
+    // Orders we don't own are the caller's to update
+    QuoteSide *side = find_side(order);
+    if (side != NULL) {
+      int32_t price = new_price == liquibook::book::PRICE_UNCHANGED
+                          ? order->price()
+                          : int32_t(new_price);
+      side->order.accept_replace(
+          uint32_t(int64_t(side->order.order_qty()) + size_delta), price);
+      int64_t open = int64_t(side->open_qty) + size_delta;
+      side->open_qty = open > 0 ? liquibook::book::Quantity(open) : 0;
+    }
+    pass_envelope();
+    downstream_.on_replace(order, size_delta, new_price);
+  }
+
+  /// A rejected replace leaves the quote side on its old terms
+  void on_replace_reject(SimpleOrder *const &order,
+                         const char *reason) override {
+    pass_envelope();
+    downstream_.on_replace_reject(order, reason);
+  }
+
+private:
+  struct BookEntry {
+    explicit BookEntry(Book &b) : book(&b), dirty(false) {}
+    Book *book;
+    bool dirty; // has callbacks waiting for flush()
+  };
+
+  struct QuoteSide {
+    QuoteSide(bool is_buy, const std::string &id)
+        : order(is_buy, 0, 0, id), open_qty(0) {}
+    SimpleOrder order;
+    liquibook::book::Quantity open_qty; // 0 = not resting
+  };
+
+  struct QuoteSlot {
+    QuoteSlot(uint32_t s, size_t b, const std::string &id)
+        : session(s), book(b), bid(true, id + "_B"), ask(false, id + "_A") {}
+    uint32_t session;
+    size_t book;
+    QuoteSide bid;
+    QuoteSide ask;
+  };
+
+  bool apply(uint32_t session, const QuoteEntry &entry) {
+    typename std::unordered_map<std::string, size_t>::iterator b =
+        book_index_.find(entry.symbol);
+    if (b == book_index_.end()) {
+      return false;
+    }
+    return apply_at(session, b->second, entry);
+  }
+
+  bool apply_at(uint32_t session, size_t book, const QuoteEntry &entry) {
+    if (entry.bid_qty && entry.ask_qty && entry.bid_price >= entry.ask_price) {
+      return false;
+    }
+
+    QuoteSlot &slot = find_slot(session, book, books_[book].book->symbol());
+    update(slot.book, slot.bid, entry.bid_price, entry.bid_qty);
+    update(slot.book, slot.ask, entry.ask_price, entry.ask_qty);
+    return true;
+  }
+
+  /// Move one side to new terms: replace in place, add, or pull
+  void update(size_t book, QuoteSide &side, liquibook::book::Price price,
+              liquibook::book::Quantity qty) {
+    if (qty == 0) {
+      pull(book, side);
+      return;
+    }
+    BookEntry &entry = books_[book];
+    if (side.open_qty == 0) {
+      side.order.accept_replace(uint32_t(qty), int32_t(price));
+      side.open_qty = qty;
+      entry.book->add(&side.order);
+    } else if (qty != side.open_qty ||
+               int32_t(price) != side.order.price()) {
+      int64_t delta = int64_t(qty) - int64_t(side.open_qty);
+      liquibook::book::Price new_price =
+          int32_t(price) == side.order.price() ? liquibook::book::PRICE_UNCHANGED
+                                               : price;
+      // The book locates the order by its old price: the new terms are
+      // applied only when it confirms (on_replace)
+      entry.book->replace(&side.order, delta, new_price);
+    } else {
+      return; // unchanged
+    }
+    mark_dirty(book);
+  }
+
+  void pull(size_t book, QuoteSide &side) {
+    if (side.open_qty == 0) {
+      return;
+    }
+    books_[book].book->cancel(&side.order);
+    mark_dirty(book);
+    side.open_qty = 0;
+  }
+
+  void mark_dirty(size_t book) {
+    if (!books_[book].dirty) {
+      books_[book].dirty = true;
+      dirty_.push_back(book);
+    }
+  }
+
+  /// One callback flush per touched book (only touched books are visited)
+  void flush() {
+    for (size_t i = 0; i < dirty_.size(); ++i) {
+      BookEntry &entry = books_[dirty_[i]];
+      entry.dirty = false;
+      entry.book->perform_callbacks();
+    }
+    dirty_.clear();
+  }
+
+  QuoteSlot &find_slot(uint32_t session, size_t book,
+                       const std::string &symbol) {
+    uint64_t key = (uint64_t(session) << 32) | uint64_t(book);
+    typename std::unordered_map<uint64_t, size_t>::iterator it =
+        slot_index_.find(key);
+    if (it != slot_index_.end()) {
+      return slots_[it->second];
+    }
+    slot_index_[key] = slots_.size();
+    slots_.push_back(
+        QuoteSlot(session, book, "Q" + std::to_string(session) + "_" + symbol));
+    QuoteSlot &slot = slots_.back();
+    side_index_[&slot.bid.order] = &slot.bid;
+    side_index_[&slot.ask.order] = &slot.ask;
+    return slot;
+  }
+
+  QuoteSide *find_side(const SimpleOrder *order) {
+    typename std::unordered_map<const SimpleOrder *, QuoteSide *>::iterator
+        it = side_index_.find(order);
+    return it == side_index_.end() ? NULL : it->second;
+  }
+
+  /// Pass the envelope of the event being delivered on to downstream
+  void pass_envelope() {
+    if (envelopes_ != NULL) {
+      forward_envelope(*envelopes_);
+    }
+  }
+
+  void note_fill(const SimpleOrder *order, liquibook::book::Quantity qty) {
+    QuoteSide *side = find_side(order);
+    if (side != NULL) {
+      side->open_qty = side->open_qty > qty ? side->open_qty - qty : 0;
+    }
+  }
+
+  Listener &downstream_;
+  TypedEnvelopeListener *envelopes_; // downstream_, if it is one
+  std::vector<BookEntry> books_;
+  std::vector<size_t> dirty_; // books touched since the last flush()
+  std::unordered_map<std::string, size_t> book_index_;
+  std::deque<QuoteSlot> slots_; // deque: orders never move once in a book
+  std::unordered_map<uint64_t, size_t> slot_index_; // (session, book)
+  std::unordered_map<const SimpleOrder *, QuoteSide *> side_index_;
+};
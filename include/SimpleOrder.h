@@ -1,5 +1,6 @@
 
 #pragma once
+#include <OrderFlags.h>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -13,14 +14,22 @@ public:
    * @param stop_price  (>0) activates stop behavior; 0 = none
    * @param all_or_none  require full fill or cancel
    * @param immediate_or_cancel execute immediately; cancel unfilled
+   * @param hidden  trade normally but never show in market depth
+   * @param post_only  only add liquidity; never trade on arrival
+   * @param min_qty  smallest quantity that must execute on arrival (0 = none)
+   * @param good_till_cancel  survive the close (GTC); false = DAY order
    */
   SimpleOrder(bool is_buy, uint32_t qty, int32_t price, std::string id,
               int32_t stop_price = 0, // Optional parameters
-              bool all_or_none = false, bool immediate_or_cancel = false)
+              bool all_or_none = false, bool immediate_or_cancel = false,
+              bool hidden = false, bool post_only = false,
+              uint32_t min_qty = 0, bool good_till_cancel = false)
       : is_buy_(is_buy), quantity_(qty), price_(price), order_id_(id),
         stop_price_(stop_price) // Store it!
         ,
-        all_or_none_(all_or_none), immediate_or_cancel_(immediate_or_cancel) {
+        all_or_none_(all_or_none), immediate_or_cancel_(immediate_or_cancel),
+        hidden_(hidden), post_only_(post_only), min_qty_(min_qty),
+        good_till_cancel_(good_till_cancel) {
     std::cout << "Created" << getOrderType() << "order:" << order_id_
               << std::endl;
   }
@@ -39,8 +48,34 @@ public:
   bool all_or_none() const { return all_or_none_; }
   /// @return IOC flag
   bool immediate_or_cancel() const { return immediate_or_cancel_; }
+  /// @return hidden (non-displayed) flag
+  bool hidden() const { return hidden_; }
+  /// @return post-only flag
+  bool post_only() const { return post_only_; }
+  /// @return minimum execution quantity on arrival (0 if none)
+  uint32_t min_qty() const { return min_qty_; }
+  /// @return true for GTC, false for a DAY order (canceled at the close)
+  bool good_till_cancel() const { return good_till_cancel_; }
+
+  /**
+   * Apply new terms to an order that is already in the book.
+   *
+   * Liquibook finds resting orders by price(), so after a replace is
+   * accepted (on_replace) the order must carry its new price and quantity.
+   *
+   * @param new_qty    total quantity after the replace
+   * @param new_price  price after the replace
+   */
+  void accept_replace(uint32_t new_qty, int32_t new_price) {
+    quantity_ = new_qty;
+    price_ = new_price;
+  }
 
   std::string getOrderType() const {
+    // Most orders are plain limit orders: no string building for them
+    if (order_flags(this) == PLAIN_LIMIT_ORDER) {
+      return "LIMIT";
+    }
     std::string type = "";
 
     if (price_ == 0) {
@@ -61,10 +96,31 @@ public:
       type += " (IMMEDIATE-OR-CANCEL)";
     }
 
+    if (hidden_) {
+      type = "HIDDEN " + type;
+    }
+    if (post_only_) {
+      type += " (POST-ONLY)";
+    }
+    if (min_qty_ > 0) {
+      type += " (MIN-QTY)";
+    }
+    if (good_till_cancel_) {
+      type += " (GTC)";
+    }
+
     return type;
   }
   std::string order_id_;
   std::string symbol_ = "AAPL";
+  /// Dense engine-side ID assigned by ClOrdIdInterner (all ones until
+  /// the order has passed through the gateway)
+  uint64_t internal_id_ = ~uint64_t(0);
+  /// Gateway session the order arrived on
+  uint32_t session_id_ = 0;
+  /// Set by the gateway when the ClOrdID may have been used before on the
+  /// session (a duplicate-filter Bloom hit outside the exact window)
+  bool possible_duplicate_ = false;
 
 private:
   bool is_buy_;
@@ -73,4 +129,8 @@ private:
   int32_t stop_price_;       
   bool all_or_none_;         
   bool immediate_or_cancel_; 
+  bool hidden_;
+  bool post_only_;
+  uint32_t min_qty_;
+  bool good_till_cancel_;
 };
@@ -0,0 +1,568 @@
+#pragma once
+#include <BookCallbacks.h>
+#include <LevelBook.h>
+#include <OrderIndex.h>
+#include <PriceLevel.h>
+#include <SimpleOrder.h>
+#include <book/order_listener.h>
+#include <book/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Best implied bid and offer of a spread, in spread price units (front leg
+ * minus back leg, so prices may be zero or negative).
+ * A quantity of 0 means that side has no implied liquidity.
+ */
+struct ImpliedQuote {
+  int64_t bid_price = 0;
+  liquibook::book::Quantity bid_qty = 0;
+  int64_t ask_price = 0;
+  liquibook::book::Quantity ask_qty = 0;
+};
+
+/**
+ * One spread fill against implied liquidity, with both leg executions.
+ * The leg orders are valid until the on_implied_fill() call returns.
+ */
+struct ImpliedFill {
+  SimpleOrder *spread_order = NULL;
+  SimpleOrder *front_leg = NULL; // bought when the spread is bought
+  SimpleOrder *back_leg = NULL;  // sold when the spread is bought
+  liquibook::book::Quantity qty = 0; // same on the spread and both legs
+  int64_t spread_price = 0;          // front_price - back_price
+  liquibook::book::Price front_price = 0;
+  liquibook::book::Price back_price = 0;
+};
+
+/// Receives a SpreadBook's implied fills (see set_implied_fill_listener())
+class ImpliedFillListener {
+public:
+  virtual ~ImpliedFillListener() {}
+  virtual void on_implied_fill(const ImpliedFill &fill) = 0;
+};
+
+/**
+ * ============================================================================
+ * CLASS: SpreadBook
+ * ============================================================================
+ * A calendar-spread book sitting on top of two outright LevelBooks.
+ *
+ * A calendar spread is one order to buy one futures month and sell another
+ * (e.g. buy March, sell June). Buying the spread means buying the front
+ * leg and selling the back leg; its price is front price - back price.
+ *
+ * Besides the spread orders resting here, the outright books imply spread
+ * prices ("implied-in"):
+ *
+ *   implied bid = front bid - back ask   (sell front, buy back)
+ *   implied ask = front ask - back bid   (buy front, sell back)
+ *
+ * The book listens to both outrights' BBO changes and keeps the implied
+ * quote up to date incrementally: each side depends on one side of each
+ * leg, so only the implied side whose inputs moved is recomputed.
+ *
+ * An incoming spread order trades with whichever is better, resting spread
+ * orders (first at equal prices) or implied liquidity. An implied trade
+ * sends two IOC leg orders into the outright books, each at the price of
+ * the leg's best level and sized to no more than that level holds. Hidden
+ * orders count here: they trade with the legs like any other, so the
+ * price is the executable one, which can beat implied() (built from the
+ * displayed BBOs only, since hidden liquidity is not market data). Each
+ * leg then fills in full at exactly its price, and nothing runs between
+ * the two adds, so the spread fill is atomic across the two books and
+ * its price is always the front leg's fill price minus the back leg's.
+ *
+ * The spread order's own on_fill() names the front leg as the matched
+ * order. An ImpliedFillListener (set_implied_fill_listener()) also gets
+ * both legs and their prices for every implied fill.
+ *
+ * implied_out() gives the reverse direction ("implied-out"): the outright
+ * prices that resting spread orders plus the other leg make available.
+ *
+ * Spread orders are limit orders (a price of 0 is a real spread price,
+ * not a market order) and may be IOC. Fill prices may be negative; they
+ * reach the listener as Price holding the int64_t value, so cast back.
+ *
+ * The book becomes both legs' BBO listener and forwards every change to
+ * the listener that was there before, so it can share a leg with e.g. a
+ * DarkBook. Leg orders live until perform_callbacks(), then go back to
+ * a pool: an implied trade reuses them instead of creating orders (and
+ * SimpleOrder's constructor logs), so only the busiest flush so far ever
+ * grows the pool.
+ *
+ * Events are queued and stamped like a LevelBook's (set_order_listener()
+ * with an EnvelopeListener, set_event_source()). The legs of an implied
+ * trade get the spread order's ingress time.
+ */
+class SpreadBook : public BboChangeListener<LevelBook<SimpleOrder *> > {
+public:
+  typedef LevelBook<SimpleOrder *> LegBook;
+  typedef liquibook::book::Price Price;
+  typedef liquibook::book::Quantity Quantity;
+  typedef liquibook::book::OrderConditions OrderConditions;
+  typedef liquibook::book::OrderListener<SimpleOrder *> TypedOrderListener;
+  typedef EnvelopeListener<SimpleOrder *> TypedEnvelopeListener;
+  typedef OrderQueue<SimpleOrder *> Queue;
+  typedef std::map<int64_t, Queue, std::greater<int64_t> > Bids; // best first
+  typedef std::map<int64_t, Queue, std::less<int64_t> > Asks;    // best first
+
+  /**
+   * @param symbol  spread symbol (e.g. "ESH6-ESM6")
+   * @param front   the leg bought when the spread is bought
+   * @param back    the leg sold when the spread is bought
+   */
+  SpreadBook(const std::string &symbol, LegBook &front, LegBook &back)
+      : symbol_(symbol), front_(front), back_(back), listener_(NULL),
+        implied_fill_listener_(NULL),
+        front_next_(front.bbo_listener()), back_next_(back.bbo_listener()),
+        front_bbo_(front.bbo()), back_bbo_(back.bbo()),
+        buy_leg_(true, 0, 0, symbol + "/leg", 0, false, true),
+        sell_leg_(false, 0, 0, symbol + "/leg", 0, false, true),
+        buy_legs_used_(0), sell_legs_used_(0), ingress_ns_(0) {
+    update_implied_bid();
+    update_implied_ask();
+    front.set_bbo_listener(this);
+    back.set_bbo_listener(this);
+  }
+
+  const std::string &symbol() const { return symbol_; }
+
+  void set_order_listener(TypedOrderListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(NULL);
+  }
+
+  /// Same, and stamp every event with an EventEnvelope for `listener`
+  void set_order_listener(TypedEnvelopeListener *listener) {
+    listener_ = listener;
+    callbacks_.set_envelope_listener(listener);
+  }
+
+  /**
+   * @param shard     shard ID for event envelopes
+   * @param sequence  event counter shared by the shard's books
+   */
+  void set_event_source(uint32_t shard, uint64_t *sequence) {
+    callbacks_.set_source(shard, sequence);
+  }
+
+  /// Ingress time of the next add/cancel, for its envelopes
+  void set_ingress_time(uint64_t ns) {
+    ingress_ns_ = ns;
+    callbacks_.set_ingress_time(ns);
+  }
+
+  /// Also report both legs of every implied fill to `listener` (or NULL)
+  void set_implied_fill_listener(ImpliedFillListener *listener) {
+    implied_fill_listener_ = listener;
+  }
+
+  /// @return the current implied-in quote
+  const ImpliedQuote &implied() const { return implied_; }
+
+  /**
+   * Add a spread order: trade with resting spread orders and implied
+   * liquidity, then rest the remainder (unless IOC).
+   *
+   * @return true if the order traded
+   */
+  bool add(SimpleOrder *order, OrderConditions conditions = 0) {
+    const bool traded = place(order, conditions);
+    finish();
+    return traded;
+  }
+
+  /// Cancel a resting spread order
+  void cancel(SimpleOrder *order) {
+    const Location *loc = locations_.find(order);
+    if (loc == NULL) {
+      callbacks_.cancel_reject(order, "not found");
+    } else {
+      Location where = *loc;
+      if (where.is_buy) {
+        remove(bids_, where);
+      } else {
+        remove(asks_, where);
+      }
+      callbacks_.cancel(order);
+    }
+    finish();
+  }
+
+  /**
+   * Deliver queued events: the legs' fills first, then the spread's own,
+   * then the implied fills.
+   */
+  void perform_callbacks() {
+    front_.perform_callbacks();
+    back_.perform_callbacks();
+    callbacks_.perform(listener_);
+    if (implied_fill_listener_ != NULL) {
+      for (size_t i = 0; i < implied_fills_.size(); ++i) {
+        implied_fill_listener_->on_implied_fill(implied_fills_[i]);
+      }
+    }
+    implied_fills_.clear();
+    buy_legs_used_ = 0;
+    sell_legs_used_ = 0;
+  }
+
+  /**
+   * Implied-out prices on one leg: what the best resting spread orders,
+   * combined with the other leg's BBO, offer to outright traders.
+   *
+   *   front bid = spread bid + back bid    front ask = spread ask + back ask
+   *   back bid  = front bid - spread ask   back ask  = front ask - spread bid
+   *
+   * @param front_leg  true for the front leg, false for the back leg
+   * @return the implied BBO (quantity 0 where nothing is implied)
+   */
+  Bbo implied_out(bool front_leg) const {
+    Bbo out;
+    const bool has_bid = !bids_.empty();
+    const bool has_ask = !asks_.empty();
+    const int64_t spread_bid = has_bid ? bids_.begin()->first : 0;
+    const int64_t spread_ask = has_ask ? asks_.begin()->first : 0;
+    const Quantity bid_qty = has_bid ? bids_.begin()->second.total_qty : 0;
+    const Quantity ask_qty = has_ask ? asks_.begin()->second.total_qty : 0;
+    if (front_leg) {
+      set_side(out.bid_price, out.bid_qty,
+               spread_bid + int64_t(back_bbo_.bid_price), bid_qty,
+               back_bbo_.bid_qty);
+      set_side(out.ask_price, out.ask_qty,
+               spread_ask + int64_t(back_bbo_.ask_price), ask_qty,
+               back_bbo_.ask_qty);
+    } else {
+      set_side(out.bid_price, out.bid_qty,
+               int64_t(front_bbo_.bid_price) - spread_ask, ask_qty,
+               front_bbo_.bid_qty);
+      set_side(out.ask_price, out.ask_qty,
+               int64_t(front_bbo_.ask_price) - spread_bid, bid_qty,
+               front_bbo_.ask_qty);
+    }
+    return out;
+  }
+
+  /// A leg's BBO moved: refresh the implied quote, then pass it on
+  void on_bbo_change(const LegBook *book, const Bbo &bbo) override {
+    if (book == &front_) {
+      leg_changed(true, bbo);
+      if (front_next_ != NULL) {
+        front_next_->on_bbo_change(book, bbo);
+      }
+    } else if (book == &back_) {
+      leg_changed(false, bbo);
+      if (back_next_ != NULL) {
+        back_next_->on_bbo_change(book, bbo);
+      }
+    }
+  }
+
+  void on_signals_change(const LegBook *book,
+                         const BookSignals &signals) override {
+    if (book == &front_ && front_next_ != NULL) {
+      front_next_->on_signals_change(book, signals);
+    } else if (book == &back_ && back_next_ != NULL) {
+      back_next_->on_signals_change(book, signals);
+    }
+  }
+
+  const Bids &bids() const { return bids_; }
+  const Asks &asks() const { return asks_; }
+
+private:
+  /// add() without closing the event stamp
+  bool place(SimpleOrder *order, OrderConditions conditions) {
+    const Quantity qty = order->order_qty();
+    const bool ioc = (conditions & liquibook::book::oc_immediate_or_cancel) ||
+                     order->immediate_or_cancel();
+    if (qty == 0) {
+      callbacks_.reject(order, "size must be positive");
+      return false;
+    }
+    if ((conditions & liquibook::book::oc_all_or_none) ||
+        order->all_or_none() || order->stop_price() > 0 || order->hidden() ||
+        order->post_only() || order->min_qty() > 0) {
+      callbacks_.reject(order, "only limit and IOC spread orders");
+      return false;
+    }
+    callbacks_.accept(order);
+    // Catch leg changes whose callbacks haven't been delivered yet
+    leg_changed(true, front_.bbo());
+    leg_changed(false, back_.bbo());
+
+    const int64_t limit = order->price();
+    Quantity remaining = order->is_buy() ? match(order, true, limit, qty, asks_)
+                                         : match(order, false, limit, qty, bids_);
+    if (remaining != 0) {
+      if (ioc) {
+        callbacks_.cancel(order);
+      } else if (order->is_buy()) {
+        rest(bids_, order, true, limit, remaining);
+      } else {
+        rest(asks_, order, false, limit, remaining);
+      }
+    }
+    return remaining != qty;
+  }
+
+
+  /// End of a public operation: close the event stamp
+  void finish() {
+    callbacks_.end_operation();
+    ingress_ns_ = 0;
+  }
+
+  /// Where a resting spread order sits
+  struct Location {
+    bool is_buy;
+    int64_t price;
+    size_t slot;
+  };
+
+  /// Implied-out side: needs both a spread order and the other leg
+  static void set_side(Price &price, Quantity &qty, int64_t implied_price,
+                       Quantity spread_qty, Quantity leg_qty) {
+    if (spread_qty == 0 || leg_qty == 0 || implied_price <= 0) {
+      return;
+    }
+    price = Price(implied_price);
+    qty = spread_qty < leg_qty ? spread_qty : leg_qty;
+  }
+
+  /// Only the implied side whose inputs moved is recomputed
+  void leg_changed(bool front, const Bbo &bbo) {
+    Bbo &cached = front ? front_bbo_ : back_bbo_;
+    const bool bid_moved =
+        bbo.bid_price != cached.bid_price || bbo.bid_qty != cached.bid_qty;
+    const bool ask_moved =
+        bbo.ask_price != cached.ask_price || bbo.ask_qty != cached.ask_qty;
+    cached = bbo;
+    // implied bid = front bid - back ask, implied ask = front ask - back bid
+    if (front ? bid_moved : ask_moved) {
+      update_implied_bid();
+    }
+    if (front ? ask_moved : bid_moved) {
+      update_implied_ask();
+    }
+  }
+
+  void update_implied_bid() {
+    implied_.bid_qty = front_bbo_.bid_qty < back_bbo_.ask_qty
+                           ? front_bbo_.bid_qty
+                           : back_bbo_.ask_qty;
+    implied_.bid_price =
+        int64_t(front_bbo_.bid_price) - int64_t(back_bbo_.ask_price);
+  }
+
+  void update_implied_ask() {
+    implied_.ask_qty = front_bbo_.ask_qty < back_bbo_.bid_qty
+                           ? front_bbo_.ask_qty
+                           : back_bbo_.bid_qty;
+    implied_.ask_price =
+        int64_t(front_bbo_.ask_price) - int64_t(back_bbo_.bid_price);
+  }
+
+  static bool crosses(bool is_buy, int64_t limit, int64_t price) {
+    return is_buy ? price <= limit : price >= limit;
+  }
+
+  /// Best level of a leg, hidden quantity included
+  template <class Levels>
+  static bool top_level(const Levels &levels, Price &price, Quantity &qty) {
+    if (levels.empty()) {
+      return false;
+    }
+    price = levels.begin()->first;
+    qty = levels.begin()->second.total_qty();
+    return true;
+  }
+
+  /// An implied trade the legs can execute right now
+  struct LegPrices {
+    Price front;
+    Price back;
+    Quantity qty; // the smaller of the two top levels
+    int64_t spread() const { return int64_t(front) - int64_t(back); }
+  };
+
+  /**
+   * Buying the spread buys the front leg (its asks) and sells the back leg
+   * (its bids); selling is the reverse.
+   * @return false if either leg has nothing to trade with
+   */
+  bool executable(bool is_buy, LegPrices &legs) const {
+    Quantity front_qty = 0, back_qty = 0;
+    const bool ok = is_buy ? top_level(front_.asks(), legs.front, front_qty) &&
+                                 top_level(back_.bids(), legs.back, back_qty)
+                           : top_level(front_.bids(), legs.front, front_qty) &&
+                                 top_level(back_.asks(), legs.back, back_qty);
+    if (!ok) {
+      return false;
+    }
+    legs.qty = front_qty < back_qty ? front_qty : back_qty;
+    return true;
+  }
+
+  /**
+   * Match against resting spread orders and implied liquidity, best price
+   * first; at equal prices resting spread orders go first.
+   * @return quantity left unfilled
+   */
+  template <class Levels>
+  Quantity match(SimpleOrder *order, bool is_buy, int64_t limit, Quantity qty,
+                 Levels &contra) {
+    LegPrices legs;
+    while (qty != 0) {
+      const bool resting =
+          !contra.empty() && crosses(is_buy, limit, contra.begin()->first);
+      const bool implied = legs_open() && executable(is_buy, legs) &&
+                           crosses(is_buy, limit, legs.spread());
+      if (!resting && !implied) {
+        break;
+      }
+      if (resting &&
+          (!implied || crosses(is_buy, legs.spread(), contra.begin()->first))) {
+        qty -= fill_resting(order, contra, qty);
+      } else {
+        qty -= trade_implied(order, is_buy, qty, legs);
+      }
+    }
+    return qty;
+  }
+
+  /// FIFO through the best resting spread level
+  template <class Levels>
+  Quantity fill_resting(SimpleOrder *order, Levels &contra, Quantity qty) {
+    typename Levels::iterator it = contra.begin();
+    Queue &queue = it->second;
+    Quantity filled = 0;
+    for (size_t slot = queue.head; slot < queue.orders.size() && filled < qty;
+         ++slot) {
+      Quantity open = queue.open_qty[slot];
+      if (open == 0) {
+        continue;
+      }
+      Quantity fill = open < qty - filled ? open : qty - filled;
+      callbacks_.fill(order, queue.orders[slot], fill, Price(it->first));
+      if (queue.reduce(slot, fill)) {
+        locations_.erase(queue.orders[slot]);
+      }
+      filled += fill;
+    }
+    if (queue.empty()) {
+      contra.erase(it);
+    }
+    return filled;
+  }
+
+  /**
+   * Trade against the outright books: one IOC order per leg, at the price
+   * of its best level, for no more than both those levels hold, so both
+   * fill in full at exactly those prices.
+   */
+  Quantity trade_implied(SimpleOrder *order, bool is_buy, Quantity qty,
+                         const LegPrices &legs) {
+    Quantity fill = qty < legs.qty ? qty : legs.qty;
+    // Buying the spread buys the front leg and sells the back leg
+    SimpleOrder *front_leg =
+        leg_order(is_buy, fill, legs.front, order->order_id_, "/front");
+    SimpleOrder *back_leg =
+        leg_order(!is_buy, fill, legs.back, order->order_id_, "/back");
+    front_.set_ingress_time(ingress_ns_);
+    front_.add(front_leg);
+    back_.set_ingress_time(ingress_ns_);
+    back_.add(back_leg);
+    callbacks_.fill(order, front_leg, fill, Price(legs.spread()));
+
+    ImpliedFill implied;
+    implied.spread_order = order;
+    implied.front_leg = front_leg;
+    implied.back_leg = back_leg;
+    implied.qty = fill;
+    implied.spread_price = legs.spread();
+    implied.front_price = legs.front;
+    implied.back_price = legs.back;
+    implied_fills_.push_back(implied);
+
+    // The legs' BBOs moved; their listeners hear at perform_callbacks(),
+    // but the next match step needs the new implied quote now
+    leg_changed(true, front_.bbo());
+    leg_changed(false, back_.bbo());
+    return fill;
+  }
+
+  /// An IOC leg order from the pool, with new terms and ID
+  SimpleOrder *leg_order(bool is_buy, Quantity qty, Price price,
+                         const std::string &spread_id, const char *suffix) {
+    std::deque<SimpleOrder> &pool = is_buy ? buy_legs_ : sell_legs_;
+    size_t &used = is_buy ? buy_legs_used_ : sell_legs_used_;
+    if (used == pool.size()) {
+      pool.push_back(is_buy ? buy_leg_ : sell_leg_); // copying doesn't log
+    }
+    SimpleOrder &leg = pool[used++];
+    leg.accept_replace(uint32_t(qty), int32_t(price));
+    leg.order_id_.assign(spread_id);
+    leg.order_id_ += suffix;
+    return &leg;
+  }
+
+  bool legs_open() const {
+    return front_.state() == STATE_CONTINUOUS &&
+           back_.state() == STATE_CONTINUOUS;
+  }
+
+  template <class Levels>
+  void rest(Levels &side, SimpleOrder *order, bool is_buy, int64_t price,
+            Quantity qty) {
+    Location where;
+    where.is_buy = is_buy;
+    where.price = price;
+    where.slot = side[price].push_back(order, qty);
+    locations_[order] = where;
+  }
+
+  template <class Levels> void remove(Levels &side, const Location &where) {
+    typename Levels::iterator it = side.find(where.price);
+    Queue &queue = it->second;
+    locations_.erase(queue.orders[where.slot]);
+    queue.reduce(where.slot, queue.open_qty[where.slot]);
+    if (queue.empty()) {
+      side.erase(it);
+    }
+  }
+
+  std::string symbol_;
+  LegBook &front_;
+  LegBook &back_;
+  TypedOrderListener *listener_;
+  ImpliedFillListener *implied_fill_listener_;
+  LegBook::TypedBboListener *front_next_; // previous BBO listeners
+  LegBook::TypedBboListener *back_next_;
+  Bbo front_bbo_; // last BBO seen per leg
+  Bbo back_bbo_;
+  ImpliedQuote implied_;
+  Bids bids_;
+  Asks asks_;
+  OrderIndex<SimpleOrder *, Location> locations_;
+  CallbackQueue<SimpleOrder *> callbacks_;
+  SimpleOrder buy_leg_; // IOC templates the leg pools are copied from
+  SimpleOrder sell_leg_;
+  std::deque<SimpleOrder> buy_legs_; // deque: a leg never moves
+  std::deque<SimpleOrder> sell_legs_;
+  size_t buy_legs_used_;  // in use until perform_callbacks()
+  size_t sell_legs_used_;
+  uint64_t ingress_ns_; // of the operation in progress, for the legs
+  std::vector<ImpliedFill> implied_fills_; // until perform_callbacks()
+};
+
+/// Lets OrderGateway pass ingress times to a SpreadBook
+inline void set_ingress_time(SpreadBook &book, uint64_t ns) {
+  book.set_ingress_time(ns);
+}
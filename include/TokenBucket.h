@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * ============================================================================
+ * CLASS: TokenBucket
+ * ============================================================================
+ * Rate limiter: allows `rate` actions per second with bursts up to `burst`.
+ *
+ * Picture a bucket that holds at most `burst` tokens and refills at `rate`
+ * tokens per second. Each order takes one token; an order arriving at an
+ * empty bucket is throttled.
+ *
+ * All arithmetic is integer nanoseconds: one token is stored as 1e9 units,
+ * and each elapsed nanosecond adds `rate` units. No floating point, no
+ * rounding drift over a long session.
+ */
+class TokenBucket {
+public:
+  static const uint64_t NANOS_PER_SECOND = 1000000000ULL;
+
+  /**
+   * @param rate    tokens added per second (0 = unlimited)
+   * @param burst   bucket size in tokens (starts full)
+   */
+  explicit TokenBucket(uint64_t rate = 0, uint64_t burst = 1)
+      : rate_(rate), capacity_((burst ? burst : 1) * NANOS_PER_SECOND),
+        units_(capacity_), last_ns_(0), started_(false) {}
+
+  /**
+   * Take one token if available.
+   *
+   * @param now_ns  current monotonic time in nanoseconds
+   * @return true if allowed, false if throttled
+   */
+  bool try_consume(uint64_t now_ns) {
+    if (rate_ == 0) {
+      return true;
+    }
+    refill(now_ns);
+    if (units_ < NANOS_PER_SECOND) {
+      return false;
+    }
+    units_ -= NANOS_PER_SECOND;
+    return true;
+  }
+
+  /// @return whole tokens currently available
+  uint64_t tokens() const { return units_ / NANOS_PER_SECOND; }
+
+private:
+  void refill(uint64_t now_ns) {
+    if (!started_) {
+      started_ = true;
+      last_ns_ = now_ns;
+      return;
+    }
+    if (now_ns <= last_ns_) {
+      return;
+    }
+    uint64_t elapsed = now_ns - last_ns_;
+    last_ns_ = now_ns;
+    // Cap elapsed time first so elapsed * rate_ cannot overflow
+    uint64_t room = capacity_ - units_;
+    if (elapsed >= room / rate_ + 1) {
+      units_ = capacity_;
+    } else {
+      units_ += elapsed * rate_;
+    }
+  }
+
+  uint64_t rate_;
+  uint64_t capacity_; // in units (tokens * 1e9)
+  uint64_t units_;
+  uint64_t last_ns_;
+  bool started_;
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Trading phase of one symbol. Stored as a single byte in each book, so
+ * the order path checks it with one compare.
+ */
+enum SessionState : uint8_t {
+  STATE_PRE_OPEN,        // before the open: orders rejected, cancels allowed
+  STATE_OPENING_AUCTION, // orders collected without matching
+  STATE_CONTINUOUS,      // normal matching
+  STATE_HALTED,          // trading stopped: new orders rejected
+  STATE_CLOSING_AUCTION, // orders collected without matching
+  STATE_CLOSED           // end of day
+};
+
+/// @return printable state name
+inline const char *session_state_name(SessionState state) {
+  switch (state) {
+  case STATE_PRE_OPEN:
+    return "PRE-OPEN";
+  case STATE_OPENING_AUCTION:
+    return "OPENING AUCTION";
+  case STATE_CONTINUOUS:
+    return "CONTINUOUS";
+  case STATE_HALTED:
+    return "HALTED";
+  case STATE_CLOSING_AUCTION:
+    return "CLOSING AUCTION";
+  case STATE_CLOSED:
+    return "CLOSED";
+  }
+  return "?";
+}
+
+/// @return true while orders are collected for an auction
+inline bool is_auction(SessionState state) {
+  return state == STATE_OPENING_AUCTION || state == STATE_CLOSING_AUCTION;
+}
+
+/**
+ * @return true if a symbol may move from one state to another
+ *
+ *   PRE_OPEN -> OPENING_AUCTION -> CONTINUOUS -> CLOSING_AUCTION -> CLOSED
+ *
+ * plus halts from (and reopening out of) any trading state, and CLOSED ->
+ * PRE_OPEN for the next day.
+ */
+inline bool valid_transition(SessionState from, SessionState to) {
+  // Bit n set = may move to state n
+  static const uint8_t allowed[] = {
+      /* PRE_OPEN        */ 1 << STATE_OPENING_AUCTION | 1 << STATE_CONTINUOUS |
+          1 << STATE_HALTED | 1 << STATE_CLOSED,
+      /* OPENING_AUCTION */ 1 << STATE_CONTINUOUS | 1 << STATE_HALTED,
+      /* CONTINUOUS      */ 1 << STATE_HALTED | 1 << STATE_CLOSING_AUCTION |
+          1 << STATE_CLOSED,
+      /* HALTED          */ 1 << STATE_OPENING_AUCTION | 1 << STATE_CONTINUOUS |
+          1 << STATE_CLOSED,
+      /* CLOSING_AUCTION */ 1 << STATE_CLOSED | 1 << STATE_HALTED,
+      /* CLOSED          */ 1 << STATE_PRE_OPEN};
+  return from <= STATE_CLOSED && to <= STATE_CLOSED &&
+         (allowed[from] & (1 << to)) != 0;
+}
+
+/**
+ * ============================================================================
+ * CLASS: SessionSchedule
+ * ============================================================================
+ * The trading day as a list of timed transitions, e.g.
+ *
+ *   09:25:00  group 0 -> OPENING_AUCTION
+ *   09:30:00  group 0 -> CONTINUOUS
+ *   15:55:00  group 0 -> CLOSING_AUCTION
+ *   16:00:00  group 0 -> CLOSED
+ *
+ * A schedule group is a set of symbols that share a timetable (e.g. all
+ * equities, or one futures product). Thousands of symbols in a group move
+ * together: each due entry becomes one batch per shard in the
+ * BookManager, not one message per symbol.
+ */
+class SessionSchedule {
+public:
+  struct Entry {
+    uint64_t at_ns;     // time the transition is due (e.g. ns since midnight)
+    uint16_t group;     // schedule group it applies to
+    SessionState state; // state to move to
+  };
+
+  /// Add a transition (entries may be added in any order)
+  void add(uint64_t at_ns, uint16_t group, SessionState state) {
+    Entry entry;
+    entry.at_ns = at_ns;
+    entry.group = group;
+    entry.state = state;
+    // Stable: same-time entries keep the order they were added in
+    entries_.insert(std::upper_bound(entries_.begin() + next_, entries_.end(),
+                                     entry, earlier),
+                    entry);
+  }
+
+  /**
+   * Hand every transition due by `now_ns` to `apply`, oldest first.
+   *
+   * @param apply  called as apply(group, state), e.g. a BookManager
+   * @return number of transitions applied
+   */
+  template <class Apply> size_t advance(uint64_t now_ns, Apply &apply) {
+    size_t done = 0;
+    while (next_ < entries_.size() && entries_[next_].at_ns <= now_ns) {
+      apply.transition(entries_[next_].group, entries_[next_].state);
+      ++next_;
+      ++done;
+    }
+    return done;
+  }
+
+  /// Start the day over (next transition is the first entry again)
+  void rewind() { next_ = 0; }
+
+  /// @return time of the next transition, or ~0 if none left
+  uint64_t next_at() const {
+    return next_ < entries_.size() ? entries_[next_].at_ns : ~uint64_t(0);
+  }
+
+private:
+  static bool earlier(const Entry &a, const Entry &b) {
+    return a.at_ns < b.at_ns;
+  }
+
+  std::vector<Entry> entries_;
+  size_t next_ = 0;
+};
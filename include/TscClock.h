@@ -0,0 +1,320 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TSC_CLOCK_X86 1
+#endif
+
+/**
+ * ============================================================================
+ * CLASS: TscClock
+ * ============================================================================
+ * A nanosecond clock that costs a few cycles to read, for timestamping
+ * every book event.
+ *
+ * std::chrono::steady_clock::now() is a clock_gettime() call: cheap for a
+ * system call, but tens of nanoseconds. The CPU's time-stamp counter
+ * (TSC) counts at a fixed rate and reads in a handful of cycles, but it
+ * counts ticks, not nanoseconds. TscClock converts ticks to nanoseconds on
+ * the steady_clock timeline:
+ *
+ *   ns = ns_base + (tsc - tsc_base) * ns_per_tick
+ *
+ * - Calibration: init() measures ns_per_tick against steady_clock over a
+ *   couple of milliseconds. Call it at startup, before anything is timed
+ *   (TscCalibrator, OrderGateway and envelope stamping do); otherwise the
+ *   first now() pays for it, stalling whatever it was timing. A
+ *   TscCalibrator thread then keeps re-measuring it over an ever longer
+ *   baseline, so it gets more accurate, and slews out any drift from
+ *   steady_clock gradually instead of jumping.
+ * - Per-thread factors: each thread keeps its own copy of the conversion
+ *   and only re-reads the shared one when its generation number changes,
+ *   so a read is: one TSC read, one load of a shared counter that rarely
+ *   changes, one multiply.
+ * - Monotonic per thread only: each new calibration starts where the old
+ *   one was, so the timeline has no steps, and within a thread now()
+ *   never goes backwards, even if the thread moves to another core.
+ *   Between threads there is no such guarantee: a value read on one
+ *   thread, then handed to another, can be a little ahead of that
+ *   thread's next now(), by as much as the cores' TSCs are apart (a few
+ *   ticks on an invariant TSC) or a calibration update one thread hasn't
+ *   picked up yet. Making it global would mean a shared high-water mark
+ *   written on every read, a cache line bouncing between all the cores
+ *   that timestamp events. Compare timestamps from different threads
+ *   with that tolerance in mind (event envelopes clamp match_ns to
+ *   ingress_ns for this reason, see BookCallbacks.h). The TSC is only
+ *   trusted if the CPU reports an invariant TSC (constant rate,
+ *   synchronized across cores); otherwise, and on non-x86 machines,
+ *   now() is steady_clock.
+ *
+ * Everything is static: there is one clock per process.
+ */
+class TscClock {
+public:
+  /**
+   * Calibrate now (a ~2 ms spin, once per process). Later calls return at
+   * once.
+   */
+  static void init() { shared_state(); }
+
+  /// @return nanoseconds on the steady_clock timeline, never less than
+  ///         the last value returned on this thread
+  static uint64_t now() {
+    Local &local = local_state();
+    Shared &shared = shared_state();
+    if (local.generation !=
+        shared.generation.load(std::memory_order_acquire)) {
+      reload(local, shared);
+    }
+    uint64_t ns =
+        local.cal.mult ? local.cal.to_ns(read_tsc()) : steady_ns();
+    if (ns < local.last) {
+      ns = local.last;
+    }
+    local.last = ns;
+    return ns;
+  }
+
+  /// @return true if now() reads the TSC (false = steady_clock fallback)
+  static bool uses_tsc() { return shared_state().mult.load() != 0; }
+
+  /// @return the current nanoseconds-per-tick estimate (0 = no TSC)
+  static double ns_per_tick() {
+    return double(shared_state().mult.load()) / double(ONE);
+  }
+
+  /**
+   * Re-measure the tick rate against steady_clock and publish a new
+   * conversion. TscCalibrator calls this periodically.
+   *
+   * @param interval_ns  time until the next call; any error against
+   *                     steady_clock is slewed out over that long
+   */
+  static void calibrate(uint64_t interval_ns) {
+    Shared &shared = shared_state();
+    if (shared.mult.load() == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(shared.calibrating);
+    uint64_t tsc, ns;
+    sample(tsc, ns);
+
+    // Rate from the first sample to this one: the baseline grows with
+    // every call, so the estimate keeps improving
+    double rate =
+        double(ns - shared.anchor_ns) / double(tsc - shared.anchor_tsc);
+
+    // Start the new conversion where the current one is now (no step),
+    // steering toward steady_clock over the next interval
+    Calibration current = load(shared);
+    uint64_t ours = current.to_ns(tsc);
+    double error = double(int64_t(ns - ours));
+    double limit = double(interval_ns) / 1000; // slew at most 0.1%
+    error = error > limit ? limit : (error < -limit ? -limit : error);
+    double ticks = double(interval_ns) / rate;
+    double ns_per_tick = (double(interval_ns) + error) / ticks;
+
+    Calibration next;
+    next.tsc_base = tsc;
+    next.ns_base = ours;
+    next.mult = uint64_t(ns_per_tick * double(ONE));
+    store(shared, next);
+  }
+
+private:
+  static const uint64_t ONE = uint64_t(1) << 32; // mult is 32.32 fixed point
+
+  /// ns = ns_base + (tsc - tsc_base) * mult / 2^32
+  struct Calibration {
+    Calibration() : tsc_base(0), ns_base(0), mult(0) {}
+    uint64_t tsc_base;
+    uint64_t ns_base;
+    uint64_t mult;
+
+    uint64_t to_ns(uint64_t tsc) const {
+      if (tsc <= tsc_base) {
+        return ns_base; // another core's TSC a few ticks behind
+      }
+      return ns_base + mul_shift32(tsc - tsc_base, mult);
+    }
+  };
+
+  /// a * b / 2^32, without overflowing as long as the result fits
+  static uint64_t mul_shift32(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return uint64_t((unsigned __int128)a * b >> 32);
+#else
+    // 32-bit targets: split both into 32-bit halves
+    uint64_t a_hi = a >> 32, a_lo = a & 0xffffffffu;
+    uint64_t b_hi = b >> 32, b_lo = b & 0xffffffffu;
+    return (a_hi * b_hi << 32) + a_hi * b_lo + a_lo * b_hi +
+           (a_lo * b_lo >> 32);
+#endif
+  }
+
+  /// The published conversion, guarded by a sequence lock: `generation` is
+  /// odd while an update is being written
+  struct Shared {
+    Shared() : generation(0), tsc_base(0), ns_base(0), mult(0) {
+      if (!invariant_tsc()) {
+        return;
+      }
+      sample(anchor_tsc, anchor_ns);
+      uint64_t tsc, ns;
+      do {
+        sample(tsc, ns);
+      } while (ns - anchor_ns < 2000000); // 2 ms first estimate
+      Calibration first;
+      first.tsc_base = tsc;
+      first.ns_base = ns;
+      first.mult = uint64_t(double(ns - anchor_ns) /
+                            double(tsc - anchor_tsc) * double(ONE));
+      store(*this, first);
+    }
+
+    std::atomic<uint32_t> generation;
+    std::atomic<uint64_t> tsc_base;
+    std::atomic<uint64_t> ns_base;
+    std::atomic<uint64_t> mult;
+    uint64_t anchor_tsc; // first sample, the start of the rate baseline
+    uint64_t anchor_ns;
+    std::mutex calibrating;
+  };
+
+  struct Local {
+    Local() : generation(~0u), last(0) {}
+    uint32_t generation; // of `cal`; ~0 = never loaded
+    Calibration cal;
+    uint64_t last; // last value returned on this thread
+  };
+
+  static Shared &shared_state() {
+    static Shared shared;
+    return shared;
+  }
+
+  static Local &local_state() {
+    static thread_local Local local;
+    return local;
+  }
+
+  static void reload(Local &local, Shared &shared) {
+    uint32_t generation;
+    do {
+      generation = shared.generation.load(std::memory_order_acquire);
+      local.cal = load(shared);
+    } while ((generation & 1) ||
+             generation != shared.generation.load(std::memory_order_acquire));
+    local.generation = generation;
+  }
+
+  static Calibration load(const Shared &shared) {
+    Calibration cal;
+    cal.tsc_base = shared.tsc_base.load(std::memory_order_acquire);
+    cal.ns_base = shared.ns_base.load(std::memory_order_acquire);
+    cal.mult = shared.mult.load(std::memory_order_acquire);
+    return cal;
+  }
+
+  static void store(Shared &shared, const Calibration &cal) {
+    uint32_t generation = shared.generation.load(std::memory_order_relaxed);
+    shared.generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    shared.tsc_base.store(cal.tsc_base, std::memory_order_relaxed);
+    shared.ns_base.store(cal.ns_base, std::memory_order_relaxed);
+    shared.mult.store(cal.mult, std::memory_order_relaxed);
+    shared.generation.store(generation + 2, std::memory_order_release);
+  }
+
+  /// A (tsc, steady_clock) pair read as close together as possible: the
+  /// tightest of a few tries, with ns taken mid-way
+  static void sample(uint64_t &tsc, uint64_t &ns) {
+    tsc = ns = 0;
+    uint64_t best = ~uint64_t(0);
+    for (int i = 0; i < 5; ++i) {
+      uint64_t before = steady_ns();
+      uint64_t t = read_tsc();
+      uint64_t after = steady_ns();
+      if (after - before < best) {
+        best = after - before;
+        tsc = t;
+        ns = before + (after - before) / 2;
+      }
+    }
+  }
+
+  static bool invariant_tsc() {
+#if TSC_CLOCK_X86
+    unsigned eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+        eax < 0x80000007) {
+      return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+  }
+
+  static uint64_t read_tsc() {
+#if TSC_CLOCK_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+};
+
+/**
+ * Background thread that keeps TscClock calibrated while it exists.
+ * Create one per process, e.g. at the top of main().
+ */
+class TscCalibrator {
+public:
+  /// @param interval  time between calibrations
+  explicit TscCalibrator(
+      std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+      : interval_(interval), stop_(false) {
+    TscClock::init(); // on this thread, not the worker
+    thread_ = std::thread(&TscCalibrator::run, this);
+  }
+
+  ~TscCalibrator() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_for(lock, interval_, [this] { return stop_; })) {
+      TscClock::calibrate(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(interval_)
+              .count());
+    }
+  }
+
+  std::chrono::milliseconds interval_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+};
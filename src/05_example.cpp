@@ -0,0 +1,172 @@
+/**
+ * ============================================================================
+ * LIQUIBOOK ORDER MATCHING ENGINE - EXAMPLE 5
+ * The Order Gateway
+ * ============================================================================
+ *
+ * This example puts a gateway in front of the order book. Clients never talk
+ * to the book directly: the gateway checks each order first.
+ *
+ * BUSINESS TERMS GLOSSARY:
+ * ============================================================================
+ *
+ * SESSION:
+ *   One logged-on client connection. Every order arrives on a session.
+ *
+ * CLORDID (Client Order ID):
+ *   The ID the client gives its own order, e.g. "BUY_001". Two different
+ *   sessions may use the same ClOrdID; within one session it must be unique.
+ *
+ * INTERNAL ID:
+ *   A small integer the engine uses instead of the ClOrdID string. Integers
+ *   are much cheaper to hash and compare than strings.
+ *
+ * RETRANSMISSION:
+ *   After a disconnect the client re-sends orders it isn't sure we got. If we
+ *   accepted them again, the client could buy twice as much as it wanted.
+ *
+ * DUPLICATE REJECT:
+ *   The gateway rejects a ClOrdID it has already seen on the session.
+ *
+ * THROTTLING:
+ *   Each session may only send so many orders per second. Extra orders are
+ *   rejected so one client can't flood the matching engine.
+ *
+ * PRIORITY LANE:
+ *   Cancels jump ahead of new orders waiting in the gateway queue.
+ *
+ * ============================================================================
+ */
+
+#include <SimpleOrder.h>
+#include <book/order_book.h>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <MyOrderListener.h>
+#include <OrderGateway.h>
+
+int main() {
+  typedef liquibook::book::OrderBook<SimpleOrder *> Book;
+
+  Book order_book;
+  MyOrderListener listener;
+
+  // The gateway listens to the book and passes each event on to ours
+  OrderGateway<Book> gateway(order_book, listener);
+  order_book.set_order_listener(&gateway);
+
+  const uint32_t ALICE = 1;
+  const uint32_t BOB = 2;
+  const uint32_t CAROL = 3;
+  gateway.open_session(ALICE);
+  gateway.open_session(BOB);
+
+  // Carol may send 1 order per second, with bursts of 2
+  SessionLimits carol_limits;
+  carol_limits.orders_per_second = 1;
+  carol_limits.burst = 2;
+  gateway.open_session(CAROL, carol_limits);
+
+  std::cout << "     LIQUIBOOK TRADING SIMULATION - EXAMPLE 5              "
+            << std::endl;
+  std::cout << "     Order Gateway: IDs, Duplicates and Throttling         "
+            << std::endl;
+
+  // ========================================================================
+  // SCENARIO 1: Normal Orders Get Internal IDs
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 1: Interning ClOrdIDs ---" << std::endl;
+  std::cout << "Alice and Bob both use ClOrdID \"ORD_1\"" << std::endl;
+  std::cout << "Expected: Both accepted, different internal IDs\n"
+            << std::endl;
+
+  SimpleOrder *alice1 = new SimpleOrder(false, 100, 5000, "ORD_1");
+  gateway.submit(ALICE, alice1);
+  gateway.process();
+  order_book.perform_callbacks();
+
+  SimpleOrder *bob1 = new SimpleOrder(true, 50, 4900, "ORD_1");
+  gateway.submit(BOB, bob1);
+  gateway.process();
+  order_book.perform_callbacks();
+
+  std::cout << "Alice's ORD_1 -> internal ID " << alice1->internal_id_
+            << std::endl;
+  std::cout << "Bob's   ORD_1 -> internal ID " << bob1->internal_id_
+            << std::endl;
+  std::cout << "Internal ID " << alice1->internal_id_ << " -> \""
+            << gateway.ids().clordid(alice1->internal_id_) << "\" on session "
+            << gateway.ids().session(alice1->internal_id_) << std::endl;
+
+  // ========================================================================
+  // SCENARIO 2: Retransmission After Reconnect
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 2: Retransmitted Order ---" << std::endl;
+  std::cout << "Alice reconnects and re-sends ORD_1" << std::endl;
+  std::cout << "Expected: Rejected as a duplicate\n" << std::endl;
+
+  SimpleOrder *alice1_again = new SimpleOrder(false, 100, 5000, "ORD_1");
+  gateway.submit(ALICE, alice1_again);
+  gateway.process();
+  order_book.perform_callbacks();
+
+  // ========================================================================
+  // SCENARIO 3: Unknown Session
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 3: Unknown Session ---" << std::endl;
+  std::cout << "An order arrives on session 99, which never logged on"
+            << std::endl;
+  std::cout << "Expected: Rejected\n" << std::endl;
+
+  SimpleOrder *stray = new SimpleOrder(true, 10, 5000, "ORD_X");
+  gateway.submit(99, stray);
+  gateway.process();
+  order_book.perform_callbacks();
+
+  // ========================================================================
+  // SCENARIO 4: Throttling a Flooding Client
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 4: Throttling ---" << std::endl;
+  std::cout << "Carol sends 4 orders at once (limit: burst of 2)" << std::endl;
+  std::cout << "Expected: First 2 queued, last 2 throttled\n" << std::endl;
+
+  SimpleOrder *carol[4];
+  for (int i = 0; i < 4; ++i) {
+    carol[i] = new SimpleOrder(true, 10, 4500 + i, "C_" + std::to_string(i));
+    gateway.submit(CAROL, carol[i]);
+  }
+
+  // ========================================================================
+  // SCENARIO 5: Cancels Overtake Queued Orders
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 5: Priority Lane ---" << std::endl;
+  std::cout << "Bob cancels ORD_1 while Carol's orders are still queued"
+            << std::endl;
+  std::cout << "Expected: Bob's cancel is processed first\n" << std::endl;
+
+  gateway.cancel(BOB, bob1);
+  gateway.process();
+  order_book.perform_callbacks();
+
+  const GatewayMetrics &m = gateway.metrics();
+  std::cout << "\n Gateway metrics:" << std::endl;
+  std::cout << "   Orders in:          " << m.orders_in << std::endl;
+  std::cout << "   Throttled:          " << m.orders_throttled << std::endl;
+  std::cout << "   Duplicates:         " << m.duplicates_rejected << std::endl;
+  std::cout << "   Cancels in:         " << m.cancels_in << std::endl;
+  std::cout << "   Cancels overtaking: " << m.cancels_overtaken << std::endl;
+  std::cout << "   Max queue depth:    " << m.max_queue_depth << std::endl;
+
+  delete alice1;
+  delete bob1;
+  delete alice1_again;
+  delete stray;
+  for (int i = 0; i < 4; ++i) {
+    delete carol[i];
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * ============================================================================
+ * LIQUIBOOK ORDER MATCHING ENGINE - EXAMPLE 7
+ * Hidden and Post-Only Orders
+ * ============================================================================
+ *
+ * BUSINESS TERMS GLOSSARY:
+ * ============================================================================
+ *
+ * DISPLAYED (LIT) ORDER:
+ *   A normal order. Everyone can see its price and size in market data.
+ *
+ * HIDDEN ORDER:
+ *   An order that can trade but is never shown in market data. Large
+ *   traders use it so nobody sees how much they want to sell. At the same
+ *   price, displayed orders trade before hidden ones.
+ *
+ * MAKER / TAKER:
+ *   The order already resting in the book is the maker (it "made" the
+ *   liquidity); the incoming order that trades against it is the taker.
+ *
+ * POST-ONLY ORDER:
+ *   An order that must be a maker. If it would trade on arrival it is
+ *   rejected, or repriced one tick away so it rests instead.
+ *
+ * ============================================================================
+ */
+
+#include <SimpleOrder.h>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <LevelBook.h>
+#include <MyOrderListener.h>
+
+int main() {
+  LevelBook<SimpleOrder *> order_book("AAPL");
+  MyOrderListener listener;
+  order_book.set_order_listener(&listener);
+
+  std::cout << "     LIQUIBOOK TRADING SIMULATION - EXAMPLE 7              "
+            << std::endl;
+  std::cout << "     Hidden and Post-Only Orders                           "
+            << std::endl;
+
+  // ========================================================================
+  // SCENARIO 1: Hidden Liquidity
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 1: Hidden Order ---" << std::endl;
+  std::cout << "Alice hides 500 shares for sale at $50" << std::endl;
+  std::cout << "Bob shows 100 shares for sale at $50" << std::endl;
+  std::cout << "Expected: Market data shows only Bob's 100\n" << std::endl;
+
+  SimpleOrder *alice = new SimpleOrder(false, 500, 5000, "SELL_ALICE", 0,
+                                       false, false, true /* hidden */);
+  SimpleOrder *bob = new SimpleOrder(false, 100, 5000, "SELL_BOB");
+  order_book.add(alice);
+  order_book.add(bob);
+  order_book.perform_callbacks();
+
+  const PriceLevel<SimpleOrder *> &best_ask = order_book.asks().begin()->second;
+  std::cout << "Displayed at $50: " << best_ask.displayed_qty() << std::endl;
+  std::cout << "Tradable at $50:  " << best_ask.total_qty() << std::endl;
+
+  // ========================================================================
+  // SCENARIO 2: Taking Hidden Liquidity
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 2: Buyer Finds the Hidden Order ---"
+            << std::endl;
+  std::cout << "Carol buys 300 at $50" << std::endl;
+  std::cout << "Expected: Bob's 100 first (displayed), then 200 from Alice\n"
+            << std::endl;
+
+  SimpleOrder *carol = new SimpleOrder(true, 300, 5000, "BUY_CAROL");
+  order_book.add(carol);
+  order_book.perform_callbacks();
+
+  // ========================================================================
+  // SCENARIO 3: Post-Only Rejected
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 3: Post-Only Would Take ---" << std::endl;
+  std::cout << "Dave posts a post-only BUY at $50 (Alice still sells there)"
+            << std::endl;
+  std::cout << "Expected: Rejected instead of trading\n" << std::endl;
+
+  SimpleOrder *dave = new SimpleOrder(true, 100, 5000, "BUY_DAVE", 0, false,
+                                      false, false, true /* post-only */);
+  order_book.add(dave);
+  order_book.perform_callbacks();
+
+  // ========================================================================
+  // SCENARIO 4: Post-Only Repriced
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 4: Post-Only Repriced ---" << std::endl;
+  std::cout << "The book now reprices post-only orders instead" << std::endl;
+  std::cout << "Expected: Erin's BUY at $50 rests at $49.99\n" << std::endl;
+
+  order_book.set_post_only_mode(POST_ONLY_REPRICE);
+  SimpleOrder *erin = new SimpleOrder(true, 100, 5000, "BUY_ERIN", 0, false,
+                                      false, false, true /* post-only */);
+  order_book.add(erin);
+  order_book.perform_callbacks();
+
+  // ========================================================================
+  // SCENARIO 5: Post-Only Replaced Through the Offer
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 5: Post-Only Replaced Through the Offer ---"
+            << std::endl;
+  std::cout << "Erin moves her post-only BUY up to $50.05" << std::endl;
+  std::cout << "Expected: repriced back to $49.99, no trade\n" << std::endl;
+
+  order_book.replace(erin, 0, 5005);
+  order_book.perform_callbacks();
+
+  std::cout << "\nThe book goes back to rejecting; Erin tries $50.05 again"
+            << std::endl;
+  std::cout << "Expected: the replace is rejected, Erin stays at $49.99\n"
+            << std::endl;
+
+  order_book.set_post_only_mode(POST_ONLY_REJECT);
+  order_book.replace(erin, 0, 5005);
+  order_book.perform_callbacks();
+  std::cout << "Best bid: $" << order_book.bids().begin()->first / 100.0
+            << ", still offered at $50: "
+            << order_book.asks().begin()->second.total_qty() << std::endl;
+
+  delete alice;
+  delete bob;
+  delete carol;
+  delete dave;
+  delete erin;
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * ============================================================================
+ * LIQUIBOOK ORDER MATCHING ENGINE - EXAMPLE 8
+ * Calendar Spreads and Implied Liquidity
+ * ============================================================================
+ *
+ * BUSINESS TERMS GLOSSARY:
+ * ============================================================================
+ *
+ * OUTRIGHT:
+ *   A single futures contract month, e.g. the March contract. Each outright
+ *   has its own order book.
+ *
+ * CALENDAR SPREAD:
+ *   One order to buy one month and sell another at a price difference.
+ *   Buying the March/June spread at $0.30 means: buy March, sell June, and
+ *   pay March's price minus June's price = $0.30.
+ *
+ * IMPLIED-IN:
+ *   Spread prices built from the outright books. If March is offered at
+ *   $50.50 and June is bid at $50.20, you can buy the spread at $0.30 by
+ *   trading both outrights, even if nobody offers the spread itself.
+ *
+ * IMPLIED-OUT:
+ *   The reverse: a resting spread order plus one outright implies a price
+ *   in the other outright.
+ *
+ * LEGS:
+ *   The outright trades that make up one spread trade.
+ *
+ * ============================================================================
+ */
+
+#include <SimpleOrder.h>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <LevelBook.h>
+#include <MyOrderListener.h>
+#include <SpreadBook.h>
+
+static void print_implied(const SpreadBook &spread) {
+  const ImpliedQuote &q = spread.implied();
+  std::cout << "Implied spread: ";
+  if (q.bid_qty != 0) {
+    std::cout << q.bid_qty << " bid @ $" << q.bid_price / 100.0;
+  } else {
+    std::cout << "no bid";
+  }
+  std::cout << " / ";
+  if (q.ask_qty != 0) {
+    std::cout << q.ask_qty << " offered @ $" << q.ask_price / 100.0;
+  } else {
+    std::cout << "no offer";
+  }
+  std::cout << std::endl;
+}
+
+/// Shows both legs behind each implied spread fill
+class LegPrinter : public ImpliedFillListener {
+public:
+  void on_implied_fill(const ImpliedFill &fill) override {
+    std::cout << "Spread fill: " << fill.qty << " @ $"
+              << fill.spread_price / 100.0 << " = front "
+              << fill.front_leg->order_id_ << " @ $"
+              << fill.front_price / 100.0 << " - back "
+              << fill.back_leg->order_id_ << " @ $"
+              << fill.back_price / 100.0 << std::endl;
+  }
+};
+
+int main() {
+  LevelBook<SimpleOrder *> march("ESH");
+  LevelBook<SimpleOrder *> june("ESM");
+  MyOrderListener listener;
+  march.set_order_listener(&listener);
+  june.set_order_listener(&listener);
+
+  SpreadBook spread("ESH-ESM", march, june);
+  spread.set_order_listener(&listener);
+  LegPrinter legs;
+  spread.set_implied_fill_listener(&legs);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "     LIQUIBOOK TRADING SIMULATION - EXAMPLE 8              "
+            << std::endl;
+  std::cout << "     Calendar Spreads and Implied Liquidity                "
+            << std::endl;
+
+  // ========================================================================
+  // SCENARIO 1: Implied-In Prices
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 1: Outrights Imply a Spread ---" << std::endl;
+  std::cout << "March: 20 bid @ $50.40, 10 offered @ $50.50" << std::endl;
+  std::cout << "June:  5 bid @ $50.20, 8 offered @ $50.25" << std::endl;
+  std::cout << "Expected: spread 8 bid @ $0.15 / 5 offered @ $0.30\n"
+            << std::endl;
+
+  SimpleOrder *march_bid = new SimpleOrder(true, 20, 5040, "MAR_BID");
+  SimpleOrder *march_ask = new SimpleOrder(false, 10, 5050, "MAR_ASK");
+  SimpleOrder *june_bid = new SimpleOrder(true, 5, 5020, "JUN_BID");
+  SimpleOrder *june_ask = new SimpleOrder(false, 8, 5025, "JUN_ASK");
+  march.add(march_bid);
+  march.add(march_ask);
+  june.add(june_bid);
+  june.add(june_ask);
+  spread.perform_callbacks();
+  print_implied(spread);
+
+  // ========================================================================
+  // SCENARIO 2: Incremental Update
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 2: June Bid Improves ---" << std::endl;
+  std::cout << "Someone bids 12 June @ $50.22" << std::endl;
+  std::cout << "Expected: only the implied offer changes, to 10 @ $0.28\n"
+            << std::endl;
+
+  SimpleOrder *june_bid2 = new SimpleOrder(true, 12, 5022, "JUN_BID2");
+  june.add(june_bid2);
+  spread.perform_callbacks();
+  print_implied(spread);
+
+  // ========================================================================
+  // SCENARIO 3: Spread Order Trades Against the Outrights
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 3: Buying the Spread ---" << std::endl;
+  std::cout << "Kate buys 4 spreads at up to $0.30" << std::endl;
+  std::cout << "Expected: fills at $0.28 by buying 4 March @ $50.50 and "
+               "selling 4 June @ $50.22, both legs at once\n"
+            << std::endl;
+
+  SimpleOrder *kate = new SimpleOrder(true, 4, 30, "SPREAD_KATE");
+  spread.add(kate);
+  spread.perform_callbacks();
+  print_implied(spread);
+
+  // ========================================================================
+  // SCENARIO 4: Implied-Out
+  // ========================================================================
+  std::cout << "\n--- SCENARIO 4: A Resting Spread Implies an Outright ---"
+            << std::endl;
+  std::cout << "Liam offers 3 spreads @ $0.35 (nobody takes it)" << std::endl;
+  std::cout << "Expected: implies a March offer @ $50.60 (0.35 + June's "
+               "$50.25 offer)\n"
+            << std::endl;
+
+  SimpleOrder *liam = new SimpleOrder(false, 3, 35, "SPREAD_LIAM");
+  spread.add(liam);
+  spread.perform_callbacks();
+  Bbo out = spread.implied_out(true);
+  std::cout << "Implied March offer: " << out.ask_qty << " @ $"
+            << out.ask_price / 100.0 << std::endl;
+
+  delete march_bid;
+  delete march_ask;
+  delete june_bid;
+  delete june_ask;
+  delete june_bid2;
+  delete kate;
+  delete liam;
+
+  return 0;
+}